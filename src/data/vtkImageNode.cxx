@@ -38,6 +38,9 @@
 
 #include <vtkObjectFactory.h>
 #include <vtkImageData.h>
+#include <vtkImageHistogram.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageStencilData.h>
 #include <vtkPointData.h>
 #include <vtkDataArray.h>
 #include <vtkDICOMMetaData.h>
@@ -52,6 +55,9 @@ vtkImageNode::vtkImageNode() : FileURL()
 {
   this->Image = vtkImageData::New();
   this->MetaData = NULL;
+  this->Stencil = NULL;
+  this->Histograms[0] = NULL;
+  this->Histograms[1] = NULL;
 }
 
 // Destructor
@@ -62,6 +68,17 @@ vtkImageNode::~vtkImageNode()
     {
     this->MetaData->Delete();
     }
+  if (this->Stencil)
+    {
+    this->Stencil->Delete();
+    }
+  for (int i = 0; i < 2; i++)
+    {
+    if (this->Histograms[i])
+      {
+      this->Histograms[i]->Delete();
+      }
+    }
 }
 
 // Get generic data object
@@ -97,6 +114,86 @@ void vtkImageNode::SetMetaData(vtkDICOMMetaData *metaData)
     }
 }
 
+// Set the stencil
+void vtkImageNode::SetStencil(vtkImageStencilData *stencil)
+{
+  if (this->Stencil != stencil)
+    {
+    if (this->Stencil)
+      {
+      this->Stencil->Delete();
+      }
+    this->Stencil = stencil;
+    if (stencil)
+      {
+      stencil->Register(this);
+      }
+    this->Modified();
+    }
+}
+
+// Get the histogram, which is only recomputed if the image has changed
+vtkImageHistogram *vtkImageNode::GetHistogram(bool useStencil)
+{
+  int i = ((useStencil && this->Stencil) ? 1 : 0);
+
+  if (!this->Histograms[i])
+    {
+    vtkImageHistogram *histogram = vtkImageHistogram::New();
+    histogram->SetInputData(this->Image);
+    histogram->AutomaticBinningOn();
+    histogram->GenerateHistogramImageOff();
+    this->Histograms[i] = histogram;
+    }
+
+  // The pipeline skips the update unless the image or stencil changed
+  vtkImageStencilData *stencil = (i == 1 ? this->Stencil : NULL);
+  if (this->Histograms[i]->GetStencil() != stencil)
+    {
+    this->Histograms[i]->SetStencilData(stencil);
+    }
+  this->Histograms[i]->Update();
+
+  return this->Histograms[i];
+}
+
+// Get the voxel values at two percentiles
+void vtkImageNode::GetPercentileRange(
+  double lower, double upper, double range[2], bool useStencil)
+{
+  vtkImageHistogram *histogram = this->GetHistogram(useStencil);
+  vtkIdTypeArray *bins = histogram->GetHistogram();
+  vtkIdType n = bins->GetNumberOfTuples();
+  vtkIdType total = histogram->GetTotal();
+  double origin = histogram->GetBinOrigin();
+  double spacing = histogram->GetBinSpacing();
+
+  range[0] = origin;
+  range[1] = origin;
+  if (n == 0 || total == 0)
+    {
+    return;
+    }
+
+  // Find the first bin at which the count reaches each percentile
+  double percentiles[2] = { lower, upper };
+  for (int k = 0; k < 2; k++)
+    {
+    double target = 0.01*percentiles[k]*total;
+    vtkIdType sum = 0;
+    vtkIdType j = 0;
+    for (; j < n - 1; j++)
+      {
+      sum += bins->GetValue(j);
+      if (sum > 0 && sum >= target)
+        {
+        break;
+        }
+      }
+    range[k] = origin + j*spacing;
+    }
+}
+
 // The required PrintSelf method
 void vtkImageNode::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -104,6 +201,7 @@ void vtkImageNode::PrintSelf(ostream& os, vtkIndent indent)
 
   os << indent << "Image: " << this->Image << "\n";
   os << indent << "MetaData: " << this->MetaData << "\n";
+  os << indent << "Stencil: " << this->Stencil << "\n";
 }
 
 // Be able to set the file path for the image
@@ -43,6 +43,8 @@
 #include <string>
 
 class vtkImageData;
+class vtkImageHistogram;
+class vtkImageStencilData;
 class vtkDICOMMetaData;
 
 //! A data node for images.
@@ -87,6 +89,43 @@ public:
   //! Set the meta data into the node.
   void SetMetaData(vtkDICOMMetaData *mataData);
 
+  //! Get the stencil that masks the image, or NULL if none.
+  vtkImageStencilData *GetStencil()
+    {
+    return this->Stencil;
+    }
+
+  //! Set a stencil to mask the image, e.g. to show only the brain.
+  /*!
+   *  The stencil is stored in run-length form, so it is much smaller
+   *  than a masked copy of the image.  As with the image, the stencil
+   *  should not be the output of a pipeline.
+   */
+  void SetStencil(vtkImageStencilData *stencil);
+
+  //! Get the values at two percentiles of the image voxels.
+  /*!
+   *  The percentiles are taken from a histogram of the image, which is
+   *  computed with multiple threads the first time that it is needed
+   *  and is kept until the image or the stencil is modified.  After
+   *  that, any number of percentile ranges can be had without another
+   *  pass through the image.  If useStencil is set and the node has a
+   *  stencil, only the voxels within the stencil are counted.
+   *  \param lower The lower percentile, from 0 to 100.
+   *  \param upper The upper percentile, from 0 to 100.
+   *  \param range The voxel values at the two percentiles.
+   *  \param useStencil Count only the voxels within the stencil.
+   */
+  void GetPercentileRange(double lower, double upper, double range[2],
+                          bool useStencil = false);
+
+  //! Get the histogram of the image, computing it if necessary.
+  /*!
+   *  The histogram has one bin per integer value for integer images,
+   *  and the bin origin and spacing can be had from the filter.
+   */
+  vtkImageHistogram *GetHistogram(bool useStencil = false);
+
   //! Set the file URL for the image
   void SetFileURL(const char *url);
 
@@ -99,6 +138,10 @@ protected:
 
   vtkImageData *Image;
   vtkDICOMMetaData *MetaData;
+  vtkImageStencilData *Stencil;
+
+  //! Histograms of all voxels and of the voxels within the stencil.
+  vtkImageHistogram *Histograms[2];
 
   std::string FileURL;
 
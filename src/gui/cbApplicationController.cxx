@@ -48,3 +48,7 @@ cbApplicationController::cbApplicationController(vtkDataManager *dataManager) :
 cbApplicationController::~cbApplicationController()
 {
 }
+
+void cbApplicationController::cancel()
+{
+}
@@ -53,6 +53,14 @@ public:
   cbApplicationController(vtkDataManager *dataManager);
   ~cbApplicationController();
 
+public slots:
+  //! Request that the current long-running operation stops early.
+  /*!
+   *  The default implementation does nothing, controllers that run
+   *  cancellable operations should override it.
+  */
+  virtual void cancel();
+
 signals:
   //! Tell the cbMainWindow to display a success message.
   void displaySuccessMessage(QString message);
@@ -75,6 +83,12 @@ signals:
   //! Tell the cbMainWindow to initialize the progress bar.
   void initializeProgress(int, int);
 
+  //! Tell the cbMainWindow whether the current operation can be cancelled.
+  void enableCancel(bool);
+
+  //! Tell the cbMainWindow whether to accept input other than cancel.
+  void enableInterface(bool);
+
 protected:
   //! Pointer to the application's shared datamanager.
   vtkDataManager *dataManager;
@@ -53,10 +53,12 @@
 #include <QString>
 #include <QProgressBar>
 #include <QDockWidget>
+#include <QMenuBar>
 #include <QStringList>
 #include <QStatusBar>
 #include <QMessageBox>
 #include <QLabel>
+#include <QPushButton>
 
 #include <assert.h>
 
@@ -72,6 +74,10 @@ cbMainWindow::cbMainWindow(vtkDataManager *dataManager, QWidget *parent)
   QStatusBar *statusBar = this->statusBar();
   progressBar = new QProgressBar;
   statusBar->addPermanentWidget(progressBar);
+  cancelButton = new QPushButton("Cancel");
+  cancelButton->setVisible(false);
+  statusBar->addPermanentWidget(cancelButton);
+  connect(cancelButton, SIGNAL(clicked()), this, SIGNAL(cancelRequested()));
   rmsLabel = new QLabel("RMS=—");
   statusBar->addPermanentWidget(rmsLabel);
 
@@ -116,6 +122,22 @@ void cbMainWindow::initializeProgress(int min, int max)
   this->progressBar->setMaximum(max);
 }
 
+void cbMainWindow::enableCancel(bool enable)
+{
+  this->cancelButton->setEnabled(enable);
+  this->cancelButton->setVisible(enable);
+}
+
+void cbMainWindow::enableInterface(bool enable)
+{
+  this->menuBar()->setEnabled(enable);
+  this->qvtkWidget->setEnabled(enable);
+  QList<QDockWidget *> docks = this->findChildren<QDockWidget *>();
+  for (int i = 0; i < docks.size(); i++) {
+    docks[i]->setEnabled(enable);
+  }
+}
+
 void cbMainWindow::displaySuccessMessage(QString message)
 {
   QString success("Success! ");
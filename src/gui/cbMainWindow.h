@@ -95,6 +95,16 @@ public slots:
   //! Initialize the progress bar.
   void initializeProgress(int min, int max);
 
+  //! Show or hide the cancel button next to the progress bar.
+  void enableCancel(bool enable);
+
+  //! Enable or disable the menus, the docks and the views.
+  /*!
+   *  The cancel button is left as it is, so that an operation that
+   *  runs its own event loop can still be cancelled.
+  */
+  void enableInterface(bool enable);
+
   //! Allows an external entity to set the active tool for all toolcursors.
   void setActiveToolCursor(QCursor cur);
 
@@ -104,6 +114,10 @@ public slots:
   //! Bind actions to the tool cursor.
   virtual void bindToolCursorAction(int cursortool, int mousebutton) = 0;
 
+signals:
+  //! Emitted when the user presses the cancel button.
+  void cancelRequested();
+
 protected:
   //! Convinience method to retrieve the application directory of provided name.
   QDir appDirectoryOf(const QString &directoryname);
@@ -112,6 +126,9 @@ protected:
   QProgressBar *progressBar;
   QLabel *rmsLabel;
 
+  //! Cancels the operation that is reporting progress.
+  QPushButton *cancelButton;
+
   //! The base class for cbStageManager.
   QDockWidget *dock;
 
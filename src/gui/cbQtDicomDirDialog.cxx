@@ -46,6 +46,7 @@
 #include <QGuiApplication>
 #include <QPushButton>
 #include <QHBoxLayout>
+#include <QMessageBox>
 #include <QVBoxLayout>
 #include <QStringList>
 
@@ -195,6 +196,28 @@ QDir cbQtDicomDirDialog::directory()
   return m_FileDialog->directory();
 }
 
+//--------------------------------------------------------------------------
+QList<QStringList> cbQtDicomDirDialog::getSeriesList(
+  QWidget *parent, const QString& caption, QString *directory)
+{
+  QList<QStringList> series;
+  for (;;) {
+    cbQtDicomDirDialog dialog(parent, caption, *directory);
+    if (!dialog.exec()) {
+      break;
+    }
+    series.append(dialog.selectedFiles());
+    *directory = dialog.directory().absolutePath();
+
+    if (QMessageBox::question(parent, caption, "Open another series?") !=
+        QMessageBox::Yes) {
+      break;
+    }
+  }
+
+  return series;
+}
+
 //--------------------------------------------------------------------------
 void cbQtDicomDirDialog::chooseSeries(const QModelIndex& idx)
 {
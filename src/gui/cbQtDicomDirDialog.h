@@ -39,6 +39,7 @@
 
 #include <QDialog>
 #include <QDir>
+#include <QList>
 #include <QStringList>
 
 class QFileDialog;
@@ -75,6 +76,15 @@ public:
   //! Get the directory selected in the file dialog.
   QDir directory();
 
+  //! Ask for series one after another, until the user has no more.
+  /*!
+   *  After each series, the user is asked whether to open another.
+   *  The directory is updated to the last directory that was chosen.
+   *  An empty list is returned if the first dialog is cancelled.
+   */
+  static QList<QStringList> getSeriesList(
+    QWidget *parent, const QString& caption, QString *directory);
+
 public slots:
   //! Add files for viewing.
   void addFiles(const QStringList& files);
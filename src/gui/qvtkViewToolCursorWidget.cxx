@@ -54,6 +54,7 @@
 #include "qpainter.h"
 #include "qsignalmapper.h"
 #include "qtimer.h"
+#include "qscreen.h"
 #if defined(Q_WS_X11)
 #include "qx11info_x11.h"
 #endif
@@ -82,6 +83,17 @@ qvtkViewToolCursorWidget::qvtkViewToolCursorWidget(QWidget* p, Qt::WindowFlags f
   this->warmupDone = false;
   this->synchronized = false;
   this->LayoutSwitching = false;
+  this->ViewRect = NULL;
+  this->RenderRequestTag = 0;
+  this->MovePending = false;
+  this->PendingMoveX = 0;
+  this->PendingMoveY = 0;
+
+  // requested renders are paced to the display refresh
+  this->RenderTimer = new QTimer(this);
+  this->RenderTimer->setSingleShot(true);
+  connect(this->RenderTimer, SIGNAL(timeout()),
+          this, SLOT(renderRequested()));
   
   // For Qt 6.10+ on macOS - use native window instead of paint-on-screen
   // not sure what this will do on non-macOS systems.
@@ -114,10 +126,96 @@ qvtkViewToolCursorWidget::~qvtkViewToolCursorWidget()
 {
   // get rid of the VTK window
   this->SetRenderWindow(NULL);
+  this->SetViewRect(NULL);
 
   this->mCachedImage->Delete();
 }
 
+/*! set the view rect, and take over its requested renders
+*/
+void qvtkViewToolCursorWidget::SetViewRect(vtkViewRect *viewRect)
+{
+  if (viewRect == this->ViewRect)
+    {
+    return;
+    }
+
+  if (this->ViewRect)
+    {
+    this->ViewRect->RemoveObserver(this->RenderRequestTag);
+    this->ViewRect->UnRegister(NULL);
+    }
+
+  // the view rect is kept alive until the widget is done with it
+  this->ViewRect = viewRect;
+
+  if (this->ViewRect)
+    {
+    this->ViewRect->Register(NULL);
+    this->RenderRequestTag = this->ViewRect->AddObserver(
+      vtkViewRect::RenderRequestedEvent,
+      this, &qvtkViewToolCursorWidget::scheduleRender);
+    }
+}
+
+/*! schedule a render for the next display refresh
+*/
+void qvtkViewToolCursorWidget::scheduleRender(vtkObject *, unsigned long,
+                                              void *)
+{
+  if (this->RenderTimer->isActive())
+    {
+    return;
+    }
+
+  double rate = (this->screen() ? this->screen()->refreshRate() : 60.0);
+  qint64 interval = qRound64(1000.0/(rate > 0.0 ? rate : 60.0));
+  qint64 elapsed = (this->FrameClock.isValid() ?
+                    this->FrameClock.elapsed() : interval);
+  this->RenderTimer->start(elapsed < interval ? interval - elapsed : 0);
+}
+
+/*! do the requested render
+*/
+void qvtkViewToolCursorWidget::renderRequested()
+{
+  if (this->ViewRect)
+    {
+    this->FrameClock.restart();
+    this->flushPendingMove();
+    this->ViewRect->ProcessPendingRender();
+    }
+}
+
+/*! apply the latest mouse move, if it has not been applied yet
+*/
+void qvtkViewToolCursorWidget::flushPendingMove()
+{
+  if (!this->MovePending)
+    {
+    return;
+    }
+  this->MovePending = false;
+
+  this->ViewRect->GetRenderWindow()->SetDesiredUpdateRate(100);
+
+  int xpos = this->PendingMoveX;
+  int ypos = this->PendingMoveY;
+  if (this->FocusCursor ||
+      this->ViewRect->RequestToolCursor(xpos, ypos))
+    {
+    if(this->ViewRect->GetCursorTracking())
+      {
+      this->setCursor(this->FocusCursorShape);
+      }
+    else
+      {
+      this->setCursor(Qt::ArrowCursor);
+      }
+    }
+  this->MoveToDisplayPosition(xpos, ypos);
+}
+
 /*! get the render window
 */
 vtkRenderWindow* qvtkViewToolCursorWidget::GetRenderWindow()
@@ -393,6 +491,9 @@ void qvtkViewToolCursorWidget::moveEvent(QMoveEvent* e)
     return;
     }
 
+  // the press must come after any move that arrived before it
+  this->flushPendingMove();
+
   qreal scale = this->devicePixelRatioF();  // retina scaling
   const QPointF pos = e->position();
   int xpos = qRound(pos.x() * scale);
@@ -437,14 +538,17 @@ void qvtkViewToolCursorWidget::moveEvent(QMoveEvent* e)
   this->FocusCursor->SetModifierBits(modifier, modifierMask);
   this->FocusCursor->ComputePosition();
   this->FocusCursor->PressButton(button);
+  this->ViewRect->InvokeEvent(vtkCommand::StartInteractionEvent);
 
-  this->ViewRect->Render();
+  // render with the next frame, like the moves that follow the press
+  this->ViewRect->RequestRender();
 }
 
 /*! handle mouse release event
 */
 void qvtkViewToolCursorWidget::mouseReleaseEvent(QMouseEvent* e)
 {
+  this->flushPendingMove();
   this->ViewRect->GetRenderWindow()->SetDesiredUpdateRate(20);
 
   // If there is a focus and the button is no longer held down
@@ -479,7 +583,8 @@ void qvtkViewToolCursorWidget::mouseReleaseEvent(QMouseEvent* e)
     this->FocusCursor->SetModifierBits(modifier, modifierMask);
     this->FocusCursor->ReleaseButton(button);
     this->FocusCursor = NULL;
-    this->ViewRect->Render();
+    this->ViewRect->InvokeEvent(vtkCommand::EndInteractionEvent);
+    this->ViewRect->RequestRender();
     }
 }
 
@@ -487,26 +592,15 @@ void qvtkViewToolCursorWidget::mouseReleaseEvent(QMouseEvent* e)
 */
 void qvtkViewToolCursorWidget::mouseMoveEvent(QMouseEvent* e)
 {
-  this->ViewRect->GetRenderWindow()->SetDesiredUpdateRate(100);
-
+  // only the latest position is kept, and it is applied just before
+  // the next frame, so moves that arrive faster than the display can
+  // refresh are dropped instead of each being picked and rendered
   qreal scale = this->devicePixelRatioF();  // retina scaling
   const QPointF pos = e->position();
-  int xpos = qRound(pos.x() * scale);
-  int ypos = qRound((this->height() - 1 - pos.y()) * scale);
-  if (this->FocusCursor ||
-      this->ViewRect->RequestToolCursor(xpos, ypos))
-    {
-    if(this->ViewRect->GetCursorTracking())
-      {
-      this->setCursor(this->FocusCursorShape);
-      }
-    else
-      {
-      this->setCursor(Qt::ArrowCursor);
-      }
-    }
-  this->MoveToDisplayPosition(xpos, ypos);
-  this->ViewRect->Render();
+  this->PendingMoveX = qRound(pos.x() * scale);
+  this->PendingMoveY = qRound((this->height() - 1 - pos.y()) * scale);
+  this->MovePending = true;
+  this->ViewRect->RequestRender();
 }
 
 
@@ -572,6 +666,8 @@ void qvtkViewToolCursorWidget::wheelEvent(QWheelEvent* e)
   int modifierMask = (VTK_TOOL_SHIFT | VTK_TOOL_CONTROL);
   int button = 0;
 
+  this->flushPendingMove();
+
   qreal scale = this->devicePixelRatioF();  // retina scaling
   const QPointF pos = e->position();
   int xpos = qRound(pos.x() * scale);
@@ -614,7 +710,8 @@ void qvtkViewToolCursorWidget::wheelEvent(QWheelEvent* e)
     active->ReleaseButton(button);
   }
 
-  this->ViewRect->Render();
+  // wheel steps are applied in order, but rendered once per frame
+  this->ViewRect->RequestRender();
 }
 
 void qvtkViewToolCursorWidget::focusInEvent(QFocusEvent* vtkNotUsed(e))
@@ -37,11 +37,13 @@
 #ifndef QVTKVIEWTOOLCURSORWIDGET_H
 #define QVTKVIEWTOOLCURSORWIDGET_H
 
+#include <QElapsedTimer>
 #include <QWidget>
 
 //#include <vtkConfigure.h>
 //#include <vtkToolkits.h>
 
+class vtkObject;
 class vtkRenderWindow;
 class vtkImageData;
 class vtkToolCursor;
@@ -136,9 +138,17 @@ public Q_SLOTS:
   // the render window and the cachedImageClean() signal is emitted.
   void saveImageToCache();
 
-  void SetViewRect(vtkViewRect *viewRect) { this->ViewRect = viewRect; }
+  // Description:
+  // Set the view rect.  The widget does the renders that are requested
+  // through vtkViewRect::RequestRender(), at most one per display refresh.
+  void SetViewRect(vtkViewRect *viewRect);
   void MoveToDisplayPosition(double xp, double yp);
 
+protected Q_SLOTS:
+  // Description:
+  // Do the render that the view rect is waiting for.
+  void renderRequested();
+
 protected:
   // overloaded resize handler
   virtual void resizeEvent(QResizeEvent* event);
@@ -213,6 +223,23 @@ protected:
   bool synchronized;
   bool LayoutSwitching;
 
+  // Description:
+  // Start the render timer when the view rect requests a render.
+  void scheduleRender(vtkObject *, unsigned long, void *);
+
+  // Description:
+  // Apply the latest mouse move.  Moves are held back until the next
+  // frame, or until a button or wheel event needs them first.
+  void flushPendingMove();
+
+  QTimer *RenderTimer;
+  QElapsedTimer FrameClock;
+  unsigned long RenderRequestTag;
+
+  bool MovePending;
+  int PendingMoveX;
+  int PendingMoveY;
+
 private:
   //! unimplemented operator=
   qvtkViewToolCursorWidget const& operator=(qvtkViewToolCursorWidget const&);
@@ -0,0 +1,91 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbCancellationToken.cxx
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+
+#include "cbCancellationToken.h"
+
+#include <vtkAlgorithm.h>
+#include <vtkCommand.h>
+
+//----------------------------------------------------------------------------
+cbCancellationToken::cbCancellationToken()
+  : m_cancelled(false)
+{
+}
+
+//----------------------------------------------------------------------------
+cbCancellationToken::~cbCancellationToken()
+{
+}
+
+//----------------------------------------------------------------------------
+void cbCancellationToken::Cancel()
+{
+  m_cancelled = true;
+}
+
+//----------------------------------------------------------------------------
+void cbCancellationToken::Reset()
+{
+  m_cancelled = false;
+}
+
+//----------------------------------------------------------------------------
+bool cbCancellationToken::IsCancelled() const
+{
+  return m_cancelled;
+}
+
+//----------------------------------------------------------------------------
+unsigned long cbCancellationToken::Watch(vtkAlgorithm *algorithm)
+{
+  return algorithm->AddObserver(
+    vtkCommand::ProgressEvent, this, &cbCancellationToken::AbortCheck);
+}
+
+//----------------------------------------------------------------------------
+void cbCancellationToken::Unwatch(vtkAlgorithm *algorithm, unsigned long tag)
+{
+  algorithm->RemoveObserver(tag);
+}
+
+//----------------------------------------------------------------------------
+void cbCancellationToken::AbortCheck(vtkObject *caller, unsigned long, void *)
+{
+  if (m_cancelled) {
+    vtkAlgorithm *algorithm = static_cast<vtkAlgorithm *>(caller);
+    algorithm->SetAbortExecute(1);
+  }
+}
@@ -0,0 +1,89 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbCancellationToken.h
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+// .NAME cbCancellationToken - Shared flag for stopping long operations.
+// .SECTION Description
+// A cbCancellationToken is shared between the code that starts a long
+// operation (e.g. the application controller) and the code that does
+// the work (e.g. cbMRIRegistration).  The worker checks the token at
+// convenient points, and VTK filters can be attached to the token so
+// that they abort via AbortExecute, in the same way that
+// cbQtDicomDirThread aborts its vtkDICOMDirectory scan.
+
+#ifndef CBCANCELLATIONTOKEN_H
+#define CBCANCELLATIONTOKEN_H
+
+#include <atomic>
+
+class vtkAlgorithm;
+class vtkObject;
+
+class cbCancellationToken
+{
+public:
+  cbCancellationToken();
+  ~cbCancellationToken();
+
+  // Description:
+  // Request cancellation.  This is safe to call from any thread.
+  void Cancel();
+
+  // Description:
+  // Clear the cancellation request before starting a new operation.
+  void Reset();
+
+  // Description:
+  // Check whether cancellation has been requested.
+  bool IsCancelled() const;
+
+  // Description:
+  // Attach the token to a VTK algorithm, so that the algorithm will
+  // abort at its next progress event after Cancel() is called.  The
+  // returned tag can be given to Unwatch() if the algorithm is going
+  // to outlive the token.
+  unsigned long Watch(vtkAlgorithm *algorithm);
+  void Unwatch(vtkAlgorithm *algorithm, unsigned long tag);
+
+private:
+  cbCancellationToken(const cbCancellationToken&); // Not implemented.
+  void operator=(const cbCancellationToken&); // Not implemented.
+
+  // This method is called by watched algorithms to check the flag.
+  void AbortCheck(vtkObject *caller, unsigned long, void *);
+
+  std::atomic<bool> m_cancelled;
+};
+
+#endif // CBCANCELLATIONTOKEN_H
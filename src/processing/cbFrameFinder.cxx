@@ -0,0 +1,519 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbFrameFinder.cxx
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+#include "cbFrameFinder.h"
+#include "cbCancellationToken.h"
+#include "LeksellFiducial.h"
+
+#include <vtkFrameFinder.h>
+#include <vtkImageData.h>
+#include <vtkImageResize.h>
+#include <vtkImageStencil.h>
+#include <vtkImplicitBoolean.h>
+#include <vtkImplicitFunctionToImageStencil.h>
+#include <vtkLine.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPlane.h>
+#include <vtkProgressAccumulator.h>
+
+#include <cmath>
+
+namespace {
+
+// Get the position of a fiducial plane, and the ranges that the
+// fiducials cover in y and in z, in frame coordinates.
+double FiducialPlane(LeksellFiducial::Side side, int axis,
+                     double yrange[2], double zrange[2])
+{
+  double corners[4][3];
+  LeksellFiducial(side).GetCornerOriginPoints(corners);
+  yrange[0] = corners[0][1];
+  yrange[1] = corners[2][1];
+  zrange[0] = corners[1][2];
+  zrange[1] = corners[0][2];
+  return corners[0][axis];
+}
+
+// Add a slab of the given half-thickness around a plane to a union.
+void AddSlab(vtkImplicitBoolean *slabs, const double point[3],
+             const double normal[3], double thickness)
+{
+  double origin[3];
+  double reverse[3] = { -normal[0], -normal[1], -normal[2] };
+
+  vtkNew<vtkPlane> upper;
+  origin[0] = point[0] + thickness*normal[0];
+  origin[1] = point[1] + thickness*normal[1];
+  origin[2] = point[2] + thickness*normal[2];
+  upper->SetOrigin(origin);
+  upper->SetNormal(normal);
+
+  vtkNew<vtkPlane> lower;
+  origin[0] = point[0] - thickness*normal[0];
+  origin[1] = point[1] - thickness*normal[1];
+  origin[2] = point[2] - thickness*normal[2];
+  lower->SetOrigin(origin);
+  lower->SetNormal(reverse);
+
+  vtkNew<vtkImplicitBoolean> slab;
+  slab->SetOperationTypeToIntersection();
+  slab->AddFunction(upper);
+  slab->AddFunction(lower);
+
+  slabs->AddFunction(slab);
+}
+
+// Transform a frame point to an image point.
+void FrameToImage(vtkMatrix4x4 *frameToImage, const double f[3], double p[3])
+{
+  double h[4] = { f[0], f[1], f[2], 1.0 };
+  frameToImage->MultiplyPoint(h, h);
+  p[0] = h[0]/h[3];
+  p[1] = h[1]/h[3];
+  p[2] = h[2]/h[3];
+}
+
+// Transform a frame direction to a unit image direction.
+void FrameToImageDirection(
+  vtkMatrix4x4 *frameToImage, const double f[3], double n[3])
+{
+  double h[4] = { f[0], f[1], f[2], 0.0 };
+  frameToImage->MultiplyPoint(h, h);
+  n[0] = h[0];
+  n[1] = h[1];
+  n[2] = h[2];
+  vtkMath::Normalize(n);
+}
+
+// Find the centroid of the bright voxels within a radius of a point,
+// in the image slice that is nearest to the point.  The voxels that
+// are brighter than the midpoint of the local range are weighted by
+// how much brighter they are.  Returns false if the region is flat.
+bool SliceCentroid(vtkImageData *image, const double p[3], double radius,
+                   double c[3])
+{
+  double origin[3], spacing[3];
+  int extent[6], lo[3], hi[3];
+  image->GetOrigin(origin);
+  image->GetSpacing(spacing);
+  image->GetExtent(extent);
+  for (int j = 0; j < 3; j++) {
+    double x = (p[j] - origin[j])/spacing[j];
+    double r = (j == 2 ? 0.0 : radius/std::fabs(spacing[j]));
+    lo[j] = static_cast<int>(std::ceil(x - r - 0.5));
+    hi[j] = static_cast<int>(std::floor(x + r + 0.5));
+    lo[j] = (lo[j] < extent[2*j] ? extent[2*j] : lo[j]);
+    hi[j] = (hi[j] > extent[2*j+1] ? extent[2*j+1] : hi[j]);
+    if (lo[j] > hi[j]) {
+      return false;
+    }
+  }
+
+  // the range within the region, for the threshold
+  int k = lo[2];
+  double vmin = VTK_DOUBLE_MAX;
+  double vmax = VTK_DOUBLE_MIN;
+  for (int j = lo[1]; j <= hi[1]; j++) {
+    for (int i = lo[0]; i <= hi[0]; i++) {
+      double v = image->GetScalarComponentAsDouble(i, j, k, 0);
+      vmin = (v < vmin ? v : vmin);
+      vmax = (v > vmax ? v : vmax);
+    }
+  }
+  if (!(vmax > vmin)) {
+    return false;
+  }
+
+  double mid = 0.5*(vmin + vmax);
+  double sum[3] = { 0.0, 0.0, 0.0 };
+  double total = 0.0;
+  for (int j = lo[1]; j <= hi[1]; j++) {
+    for (int i = lo[0]; i <= hi[0]; i++) {
+      double w = image->GetScalarComponentAsDouble(i, j, k, 0) - mid;
+      if (w > 0) {
+        sum[0] += w*i;
+        sum[1] += w*j;
+        total += w;
+      }
+    }
+  }
+  c[0] = origin[0] + spacing[0]*sum[0]/total;
+  c[1] = origin[1] + spacing[1]*sum[1]/total;
+  c[2] = origin[2] + spacing[2]*k;
+
+  return true;
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+cbFrameFinder::cbFrameFinder()
+{
+  m_imageToFrameMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  m_coarseResize = vtkSmartPointer<vtkImageResize>::New();
+  m_coarseFinder = vtkSmartPointer<vtkFrameFinder>::New();
+  m_slabStencil = vtkSmartPointer<vtkImageStencil>::New();
+  m_fineFinder = vtkSmartPointer<vtkFrameFinder>::New();
+  m_filtersRegistered = false;
+  m_cancellationToken = NULL;
+  m_progressAccumulate = NULL;
+  m_useAP = false;
+  m_coarseToFine = true;
+  m_coarseSpacing = 1.5;
+  m_slabThickness = 10.0;
+  m_success = false;
+  m_usedCoarseToFine = false;
+  m_averageFiducialRMS = 0.0;
+  m_numberOfFiducials = 0;
+  for (int i = 0; i < 4; i++) {
+    m_fiducialRMS[i] = 0.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+cbFrameFinder::~cbFrameFinder()
+{
+  // the accumulator must not keep pointers to our filters
+  if (m_progressAccumulate && m_filtersRegistered) {
+    m_progressAccumulate->UnregisterAllFilters();
+  }
+}
+
+//----------------------------------------------------------------------------
+void cbFrameFinder::SetInput(vtkImageData *image)
+{
+  m_image = image;
+}
+
+//----------------------------------------------------------------------------
+void cbFrameFinder::SetDICOMPatientMatrix(vtkMatrix4x4 *matrix)
+{
+  m_patientMatrix = matrix;
+}
+
+//----------------------------------------------------------------------------
+vtkMatrix4x4 *cbFrameFinder::GetImageToFrameMatrix()
+{
+  return m_imageToFrameMatrix;
+}
+
+//----------------------------------------------------------------------------
+bool cbFrameFinder::IsCancelled()
+{
+  return (m_cancellationToken && m_cancellationToken->IsCancelled());
+}
+
+//----------------------------------------------------------------------------
+int cbFrameFinder::Execute()
+{
+  m_success = false;
+  m_usedCoarseToFine = false;
+  m_averageFiducialRMS = 0.0;
+  m_numberOfFiducials = 0;
+  m_imageToFrameMatrix->Identity();
+
+  if (!m_image) {
+    return 0;
+  }
+
+  // only go coarse-to-fine if the coarse image is substantially smaller
+  double spacing[3];
+  m_image->GetSpacing(spacing);
+  double reduction = 1.0;
+  for (int j = 0; j < 3; j++) {
+    if (spacing[j] > 0 && spacing[j] < m_coarseSpacing) {
+      reduction *= m_coarseSpacing/spacing[j];
+    }
+  }
+  bool coarseToFine = (m_coarseToFine && reduction >= 2.0);
+
+  // the fine search is used for the fallback search, too
+  m_fineFinder->SetDICOMPatientMatrix(m_patientMatrix);
+  m_fineFinder->SetUsePosteriorFiducial(m_useAP);
+  m_fineFinder->SetUseAnteriorFiducial(m_useAP);
+
+  if (!m_filtersRegistered) {
+    m_filtersRegistered = true;
+    if (m_progressAccumulate) {
+      m_progressAccumulate->RegisterFilter(m_coarseResize, 0.1f);
+      m_progressAccumulate->RegisterFilter(m_coarseFinder, 0.3f);
+      m_progressAccumulate->RegisterFilter(m_slabStencil, 0.1f);
+      m_progressAccumulate->RegisterFilter(m_fineFinder, 0.5f);
+    }
+    if (m_cancellationToken) {
+      m_cancellationToken->Watch(m_coarseResize);
+      m_cancellationToken->Watch(m_coarseFinder);
+      m_cancellationToken->Watch(m_slabStencil);
+      m_cancellationToken->Watch(m_fineFinder);
+    }
+  }
+
+  if (coarseToFine) {
+    vtkNew<vtkMatrix4x4> coarseMatrix;
+    vtkNew<vtkImageData> slabImage;
+    if (this->FindCoarseFrame(coarseMatrix) &&
+        this->MakeSlabImage(coarseMatrix, slabImage)) {
+      m_fineFinder->SetInputData(slabImage);
+      m_fineFinder->Update();
+      m_usedCoarseToFine = (m_fineFinder->GetSuccess() != 0);
+    }
+    if (this->IsCancelled()) {
+      return 0;
+    }
+  }
+
+  // search the whole image if the coarse-to-fine search was not used
+  if (!m_usedCoarseToFine) {
+    m_fineFinder->SetInputData(m_image);
+    m_fineFinder->Update();
+    if (this->IsCancelled()) {
+      return 0;
+    }
+  }
+
+  m_success = (m_fineFinder->GetSuccess() != 0);
+  m_averageFiducialRMS = m_fineFinder->GetAverageFiducialRMS();
+  if (m_success) {
+    m_imageToFrameMatrix->DeepCopy(m_fineFinder->GetImageToFrameMatrix());
+    this->ComputeFiducialRMS();
+  }
+
+  // release the intermediate images
+  m_fineFinder->SetInputData(NULL);
+  m_slabStencil->GetOutput()->ReleaseData();
+
+  return m_success;
+}
+
+//----------------------------------------------------------------------------
+void cbFrameFinder::ComputeFiducialRMS()
+{
+  vtkNew<vtkMatrix4x4> frameToImage;
+  vtkMatrix4x4::Invert(m_imageToFrameMatrix, frameToImage);
+
+  double spacing[3];
+  m_image->GetSpacing(spacing);
+  double step = std::fabs(spacing[2]);
+
+  // the search radius, and the length at the ends of each rod where
+  // the rod is too close to its neighbour to be measured on its own
+  const double radius = 4.0;
+  const double margin = 15.0;
+
+  m_numberOfFiducials = (m_useAP ? 4 : 2);
+  for (int side = 0; side < m_numberOfFiducials; side++) {
+    double corners[4][3];
+    LeksellFiducial(static_cast<LeksellFiducial::Side>(side))
+      .GetCornerOriginPoints(corners);
+
+    // each N is made of three rods that join the corners
+    double sum = 0.0;
+    int count = 0;
+    for (int rod = 0; rod < 3; rod++) {
+      double a[3], b[3];
+      FrameToImage(frameToImage, corners[rod], a);
+      FrameToImage(frameToImage, corners[rod+1], b);
+      double length = std::sqrt(vtkMath::Distance2BetweenPoints(a, b));
+      int n = static_cast<int>((length - 2*margin)/step);
+      for (int i = 0; i <= n; i++) {
+        double t = (margin + i*step)/length;
+        double p[3], c[3];
+        p[0] = a[0] + t*(b[0] - a[0]);
+        p[1] = a[1] + t*(b[1] - a[1]);
+        p[2] = a[2] + t*(b[2] - a[2]);
+        if (SliceCentroid(m_image, p, radius, c)) {
+          sum += vtkLine::DistanceToLine(c, a, b);
+          count++;
+        }
+      }
+    }
+
+    m_fiducialRMS[side] = (count > 0 ? std::sqrt(sum/count) : 0.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+int cbFrameFinder::FindCoarseFrame(vtkMatrix4x4 *imageToFrame)
+{
+  double spacing[3];
+  m_image->GetSpacing(spacing);
+  for (int j = 0; j < 3; j++) {
+    if (spacing[j] < m_coarseSpacing) {
+      spacing[j] = m_coarseSpacing;
+    }
+  }
+
+  // the resize filter does an antialiasing blur when it downsamples
+  m_coarseResize->SetInputData(m_image);
+  m_coarseResize->SetResizeMethodToOutputSpacing();
+  m_coarseResize->SetOutputSpacing(spacing);
+  m_coarseResize->Update();
+
+  if (this->IsCancelled()) {
+    return 0;
+  }
+
+  m_coarseFinder->SetInputConnection(m_coarseResize->GetOutputPort());
+  m_coarseFinder->SetDICOMPatientMatrix(m_patientMatrix);
+  m_coarseFinder->SetUsePosteriorFiducial(m_useAP);
+  m_coarseFinder->SetUseAnteriorFiducial(m_useAP);
+  m_coarseFinder->Update();
+
+  int success = (!this->IsCancelled() && m_coarseFinder->GetSuccess());
+  if (success) {
+    imageToFrame->DeepCopy(m_coarseFinder->GetImageToFrameMatrix());
+  }
+
+  // the downsampled image is no longer needed
+  m_coarseResize->GetOutput()->ReleaseData();
+
+  return success;
+}
+
+//----------------------------------------------------------------------------
+int cbFrameFinder::MakeSlabImage(
+  vtkMatrix4x4 *imageToFrame, vtkImageData *output)
+{
+  vtkNew<vtkMatrix4x4> frameToImage;
+  vtkMatrix4x4::Invert(imageToFrame, frameToImage);
+
+  // the lateral fiducials give the y and z ranges of the frame
+  double yrange[2], zrange[2], unused[2];
+  double leftX = FiducialPlane(LeksellFiducial::left, 0, yrange, zrange);
+  double rightX = FiducialPlane(LeksellFiducial::right, 0, unused, unused);
+  double frontY = FiducialPlane(LeksellFiducial::front, 1, unused, unused);
+  double backY = FiducialPlane(LeksellFiducial::back, 1, unused, unused);
+
+  double w = m_slabThickness;
+  double xmid = 0.5*(leftX + rightX);
+  double ymid = 0.5*(yrange[0] + yrange[1]);
+  double zmid = 0.5*(zrange[0] + zrange[1]);
+
+  // the box that holds the fiducials, plus a margin
+  double xmin = rightX - w;
+  double xmax = leftX + w;
+  double ymin = (m_useAP ? backY : yrange[0]) - w;
+  double ymax = (m_useAP ? frontY : yrange[1]) + w;
+  double zmin = zrange[0] - w;
+  double zmax = zrange[1] + w;
+
+  // crop the image to the bounds of the box
+  double origin[3], spacing[3];
+  int extent[6], cropExtent[6];
+  m_image->GetOrigin(origin);
+  m_image->GetSpacing(spacing);
+  m_image->GetExtent(extent);
+  for (int j = 0; j < 3; j++) {
+    cropExtent[2*j] = VTK_INT_MAX;
+    cropExtent[2*j+1] = VTK_INT_MIN;
+  }
+  for (int i = 0; i < 8; i++) {
+    double f[3], p[3];
+    f[0] = ((i & 1) ? xmax : xmin);
+    f[1] = ((i & 2) ? ymax : ymin);
+    f[2] = ((i & 4) ? zmax : zmin);
+    FrameToImage(frameToImage, f, p);
+    for (int j = 0; j < 3; j++) {
+      double x = (p[j] - origin[j])/spacing[j];
+      int lo = static_cast<int>(std::floor(x));
+      int hi = static_cast<int>(std::ceil(x));
+      if (spacing[j] < 0) {
+        int tmp = lo;
+        lo = hi;
+        hi = tmp;
+      }
+      cropExtent[2*j] = (lo < cropExtent[2*j] ? lo : cropExtent[2*j]);
+      cropExtent[2*j+1] = (hi > cropExtent[2*j+1] ? hi : cropExtent[2*j+1]);
+    }
+  }
+  for (int j = 0; j < 3; j++) {
+    if (cropExtent[2*j] < extent[2*j]) {
+      cropExtent[2*j] = extent[2*j];
+    }
+    if (cropExtent[2*j+1] > extent[2*j+1]) {
+      cropExtent[2*j+1] = extent[2*j+1];
+    }
+    if (cropExtent[2*j] > cropExtent[2*j+1]) {
+      return 0;
+    }
+  }
+
+  // the slabs around the predicted fiducial planes
+  vtkNew<vtkImplicitBoolean> slabs;
+  slabs->SetOperationTypeToUnion();
+
+  double xaxis[3] = { 1.0, 0.0, 0.0 };
+  double yaxis[3] = { 0.0, 1.0, 0.0 };
+  double normal[3], point[3];
+
+  double left[3] = { leftX, ymid, zmid };
+  double right[3] = { rightX, ymid, zmid };
+  FrameToImageDirection(frameToImage, xaxis, normal);
+  FrameToImage(frameToImage, left, point);
+  AddSlab(slabs, point, normal, w);
+  FrameToImage(frameToImage, right, point);
+  AddSlab(slabs, point, normal, w);
+
+  if (m_useAP) {
+    double front[3] = { xmid, frontY, zmid };
+    double back[3] = { xmid, backY, zmid };
+    FrameToImageDirection(frameToImage, yaxis, normal);
+    FrameToImage(frameToImage, front, point);
+    AddSlab(slabs, point, normal, w);
+    FrameToImage(frameToImage, back, point);
+    AddSlab(slabs, point, normal, w);
+  }
+
+  vtkNew<vtkImplicitFunctionToImageStencil> makeStencil;
+  makeStencil->SetInput(slabs);
+  makeStencil->SetInformationInput(m_image);
+  makeStencil->SetOutputWholeExtent(cropExtent);
+
+  // voxels outside the slabs are set to the lowest value in the image
+  m_slabStencil->SetInputData(m_image);
+  m_slabStencil->SetStencilConnection(makeStencil->GetOutputPort());
+  m_slabStencil->SetBackgroundValue(m_image->GetScalarRange()[0]);
+  m_slabStencil->UpdateExtent(cropExtent);
+
+  if (this->IsCancelled()) {
+    return 0;
+  }
+
+  output->ShallowCopy(m_slabStencil->GetOutput());
+
+  return 1;
+}
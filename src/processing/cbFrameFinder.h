@@ -0,0 +1,174 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbFrameFinder.h
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+// .NAME cbFrameFinder - Find a Leksell frame with a coarse-to-fine search.
+// .SECTION Description
+// cbFrameFinder runs vtkFrameFinder in two stages.  The frame is first
+// found in a downsampled copy of the image, which gives an approximate
+// image-to-frame matrix.  The search is then repeated at full resolution,
+// but only within slabs around the fiducial planes that are predicted
+// by the approximate matrix and the LeksellFiducial geometry, with the
+// image cropped to the frame.  If either stage fails, the frame finder
+// is run on the whole image at full resolution.
+
+#ifndef CBFRAMEFINDER_H
+#define CBFRAMEFINDER_H
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+class vtkMatrix4x4;
+class vtkFrameFinder;
+class vtkImageResize;
+class vtkImageStencil;
+class vtkProgressAccumulator;
+class cbCancellationToken;
+
+class cbFrameFinder
+{
+public:
+  static cbFrameFinder *New() {
+    return new cbFrameFinder; };
+  cbFrameFinder();
+  ~cbFrameFinder();
+
+  // Description:
+  // Set the image, and the DICOM patient matrix for the image.
+  void SetInput(vtkImageData *image);
+  void SetDICOMPatientMatrix(vtkMatrix4x4 *matrix);
+
+  // Description:
+  // Use the anterior and posterior fiducials, as well as the left
+  // and right fiducials.  The DEFAULT is to use left and right only.
+  void SetUseAnteriorPosteriorFiducials(bool use) { m_useAP = use; }
+  bool GetUseAnteriorPosteriorFiducials() { return m_useAP; }
+
+  // Description:
+  // Turn the coarse-to-fine search on or off.  It is only used if the
+  // image voxels are smaller than the coarse spacing.  The DEFAULT is on.
+  void SetCoarseToFine(bool val) { m_coarseToFine = val; }
+  bool GetCoarseToFine() { return m_coarseToFine; }
+
+  // Description:
+  // The voxel spacing, in millimetres, for the coarse search.
+  // The DEFAULT is 1.5 mm.
+  void SetCoarseSpacing(double spacing) { m_coarseSpacing = spacing; }
+  double GetCoarseSpacing() { return m_coarseSpacing; }
+
+  // Description:
+  // The half-thickness, in millimetres, of the slab that is searched
+  // around each fiducial plane in the fine search.  The DEFAULT is 10 mm.
+  void SetSlabThickness(double thickness) { m_slabThickness = thickness; }
+  double GetSlabThickness() { return m_slabThickness; }
+
+  // Description:
+  // Provide a token that can be used to stop the search early.
+  void SetCancellationToken(cbCancellationToken *token) {
+    m_cancellationToken = token; }
+
+  // Description:
+  // This provides a way to track the progress.  The accumulator is
+  // not owned by this object, and it must outlive this object.
+  void SetProgressAccumulator(vtkProgressAccumulator *progressAccumulate) {
+    m_progressAccumulate = progressAccumulate; }
+
+  // Description:
+  // Find the frame.  Returns 1 if the frame was found.
+  int Execute();
+
+  // Description:
+  // Get the results from the last Execute().
+  bool GetSuccess() { return m_success; }
+  vtkMatrix4x4 *GetImageToFrameMatrix();
+  double GetAverageFiducialRMS() { return m_averageFiducialRMS; }
+
+  // Description:
+  // Get the RMS residual, in millimetres, for each fiducial that was
+  // used, in the order left, right, anterior, posterior.  This is the
+  // distance of the rods, as they appear in each slice, from the rods
+  // as placed by the image-to-frame matrix.  There are no fiducials
+  // unless the frame was found.
+  int GetNumberOfFiducials() { return m_numberOfFiducials; }
+  double GetFiducialRMS(int i) { return m_fiducialRMS[i]; }
+
+  // Description:
+  // Check whether the result came from the coarse-to-fine search,
+  // rather than from a search of the whole image.
+  bool GetUsedCoarseToFine() { return m_usedCoarseToFine; }
+
+protected:
+  // Description:
+  // Find the frame in the downsampled image.
+  int FindCoarseFrame(vtkMatrix4x4 *imageToFrame);
+
+  // Description:
+  // Make the cropped and masked full-resolution image for the fine
+  // search, given the approximate image-to-frame matrix.
+  int MakeSlabImage(vtkMatrix4x4 *imageToFrame, vtkImageData *output);
+
+  // Description:
+  // Measure the residual for each fiducial, after the frame is found.
+  void ComputeFiducialRMS();
+
+  // Description:
+  // Check whether the search was cancelled.
+  bool IsCancelled();
+
+private:
+  cbFrameFinder(const cbFrameFinder&); // Not implemented.
+  void operator=(const cbFrameFinder&); // Not implemented.
+
+  vtkSmartPointer<vtkImageData> m_image;
+  vtkSmartPointer<vtkMatrix4x4> m_patientMatrix;
+  vtkSmartPointer<vtkMatrix4x4> m_imageToFrameMatrix;
+  vtkSmartPointer<vtkImageResize> m_coarseResize;
+  vtkSmartPointer<vtkFrameFinder> m_coarseFinder;
+  vtkSmartPointer<vtkImageStencil> m_slabStencil;
+  vtkSmartPointer<vtkFrameFinder> m_fineFinder;
+  cbCancellationToken *m_cancellationToken;
+  vtkProgressAccumulator *m_progressAccumulate;
+  bool m_filtersRegistered;
+  bool m_useAP;
+  bool m_coarseToFine;
+  double m_coarseSpacing;
+  double m_slabThickness;
+  bool m_success;
+  bool m_usedCoarseToFine;
+  double m_averageFiducialRMS;
+  int m_numberOfFiducials;
+  double m_fiducialRMS[4];
+};
+
+#endif // CBFRAMEFINDER_H
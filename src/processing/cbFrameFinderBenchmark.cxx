@@ -0,0 +1,200 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbFrameFinderBenchmark.cxx
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+// .NAME cbFrameFinderBenchmark - Measure the speed and accuracy of frame finding.
+// .SECTION Description
+// This program uses cbFramePhantom to make MR-like and CT-like images of
+// a Leksell frame at known poses, with several slice spacings and noise
+// levels, and runs cbFrameFinder on each of them with and without the
+// coarse-to-fine search.  One JSON object is written per run (JSON Lines)
+// with the time, the success flag, the RMS reported by the frame finder,
+// and the error of the image-to-frame matrix at the fiducial corners.
+//
+// Usage: cbFrameFinderBenchmark [--output file] [--ap]
+//
+// Use --ap to add the anterior and posterior fiducials to the phantom,
+// and to use them for frame finding.
+
+#include "cbFrameFinder.h"
+#include "cbFramePhantom.h"
+
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkTimerLog.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+//----------------------------------------------------------------------------
+// A known frame pose: rotations (degrees) and translation (mm)
+struct Pose
+{
+  double Rotation[3];
+  double Translation[3];
+};
+
+const Pose Poses[] = {
+  { {  0.0, 0.0,  0.0 }, {  0.0,  0.0,  0.0 } },
+  { {  5.0, 0.0,  0.0 }, {  2.0, -3.0,  1.0 } },
+  { {  0.0, 8.0, -4.0 }, { -5.0,  4.0,  6.0 } },
+  { { -6.0, 3.0, 10.0 }, {  8.0,  2.0, -4.0 } }
+};
+
+const double SliceSpacings[] = { 1.0, 2.0, 3.0 };
+
+const double NoiseLevels[] = { 0.0, 0.05, 0.15 };
+
+//----------------------------------------------------------------------------
+// Run the frame finder on one phantom, and write the results as one
+// line of JSON
+void RunBenchmark(cbFramePhantom *phantom, int poseIndex, bool coarseToFine,
+                  bool useAP, std::ostream& os)
+{
+  cbFrameFinder *finder = cbFrameFinder::New();
+  finder->SetInput(phantom->GetOutput());
+  finder->SetDICOMPatientMatrix(phantom->GetPatientMatrix());
+  finder->SetUseAnteriorPosteriorFiducials(useAP);
+  finder->SetCoarseToFine(coarseToFine);
+
+  double startTime = vtkTimerLog::GetUniversalTime();
+  finder->Execute();
+  double wallTime = vtkTimerLog::GetUniversalTime() - startTime;
+
+  double error = -1.0;
+  if (finder->GetSuccess())
+  {
+    error = cbFramePhantom::MatrixError(finder->GetImageToFrameMatrix(),
+                                        phantom->GetImageToFrameMatrix(),
+                                        useAP);
+  }
+
+  os << "{\"modality\": \""
+     << (phantom->GetModalityIsCT() ? "CT" : "MR") << "\""
+     << ", \"pose\": " << poseIndex
+     << ", \"slice_spacing\": " << phantom->GetSliceSpacing()
+     << ", \"noise\": " << phantom->GetNoiseLevel()
+     << ", \"ap\": " << (useAP ? "true" : "false")
+     << ", \"coarse_to_fine\": " << (coarseToFine ? "true" : "false")
+     << ", \"used_coarse_to_fine\": "
+     << (finder->GetUsedCoarseToFine() ? "true" : "false")
+     << ", \"wall_time\": " << wallTime
+     << ", \"success\": " << (finder->GetSuccess() ? "true" : "false")
+     << ", \"fiducial_rms\": " << finder->GetAverageFiducialRMS()
+     << ", \"matrix_error\": " << error << "}" << std::endl;
+
+  delete finder;
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  std::string outputFile;
+  bool useAP = false;
+
+  for (int argi = 1; argi < argc; argi++)
+  {
+    std::string arg = argv[argi];
+    if (arg == "--output" && argi + 1 < argc)
+    {
+      outputFile = argv[++argi];
+    }
+    else if (arg == "--ap")
+    {
+      useAP = true;
+    }
+    else
+    {
+      std::cerr << "Usage: " << argv[0]
+                << " [--output file] [--ap]" << std::endl;
+      return 1;
+    }
+  }
+
+  std::ofstream ofile;
+  if (!outputFile.empty())
+  {
+    ofile.open(outputFile.c_str());
+    if (!ofile.good())
+    {
+      std::cerr << "Cannot write to " << outputFile << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& os = (outputFile.empty() ? std::cout : ofile);
+
+  const int numberOfPoses = sizeof(Poses)/sizeof(Pose);
+  const int numberOfSpacings = sizeof(SliceSpacings)/sizeof(double);
+  const int numberOfNoiseLevels = sizeof(NoiseLevels)/sizeof(double);
+
+  cbFramePhantom *phantom = cbFramePhantom::New();
+  phantom->SetUseAnteriorPosteriorFiducials(useAP);
+
+  // 0 is MR, 1 is CT
+  for (int modality = 0; modality < 2; modality++)
+  {
+    if (modality == 0)
+    {
+      phantom->SetModalityToMR();
+    }
+    else
+    {
+      phantom->SetModalityToCT();
+    }
+    for (int i = 0; i < numberOfPoses; i++)
+    {
+      phantom->SetPose(Poses[i].Rotation, Poses[i].Translation);
+      for (int j = 0; j < numberOfSpacings; j++)
+      {
+        phantom->SetSliceSpacing(SliceSpacings[j]);
+        for (int k = 0; k < numberOfNoiseLevels; k++)
+        {
+          phantom->SetNoiseLevel(NoiseLevels[k]);
+          phantom->Execute();
+          RunBenchmark(phantom, i, false, useAP, os);
+          RunBenchmark(phantom, i, true, useAP, os);
+        }
+      }
+    }
+  }
+
+  delete phantom;
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbFramePhantom.cxx
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+#include "cbFramePhantom.h"
+#include "LeksellFiducial.h"
+
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkTransform.h>
+
+#include <cmath>
+
+namespace {
+
+// Radius of the fiducial rods, plus the width of the blurred edge.
+const double RodRadius = 1.5;
+const double RodEdge = 1.0;
+
+// Margin around the fiducials, for the image bounds.
+const double FrameMargin = 15.0;
+
+// Squared distance from a point to a line segment.
+double SegmentDistance2(const double p[3], const double a[3],
+                        const double b[3])
+{
+  double v[3], w[3];
+  vtkMath::Subtract(b, a, v);
+  vtkMath::Subtract(p, a, w);
+  double t = vtkMath::Dot(v, w)/vtkMath::Dot(v, v);
+  t = (t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t));
+  double d[3] = {
+    w[0] - t*v[0],
+    w[1] - t*v[1],
+    w[2] - t*v[2] };
+  return vtkMath::Dot(d, d);
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+cbFramePhantom::cbFramePhantom()
+{
+  m_image = vtkSmartPointer<vtkImageData>::New();
+  m_patientMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  m_imageToFrameMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  m_ct = false;
+  m_useAP = false;
+  m_pixelSpacing = 1.0;
+  m_sliceSpacing = 1.0;
+  m_noiseLevel = 0.0;
+  m_seed = 1234u;
+  m_numberOfBars = 0;
+  for (int j = 0; j < 3; j++) {
+    m_angles[j] = 0.0;
+    m_translation[j] = 0.0;
+  }
+}
+
+//----------------------------------------------------------------------------
+cbFramePhantom::~cbFramePhantom()
+{
+}
+
+//----------------------------------------------------------------------------
+void cbFramePhantom::SetPose(const double angles[3],
+                             const double translation[3])
+{
+  for (int j = 0; j < 3; j++) {
+    m_angles[j] = angles[j];
+    m_translation[j] = translation[j];
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *cbFramePhantom::GetOutput()
+{
+  return m_image;
+}
+
+//----------------------------------------------------------------------------
+vtkMatrix4x4 *cbFramePhantom::GetPatientMatrix()
+{
+  return m_patientMatrix;
+}
+
+//----------------------------------------------------------------------------
+vtkMatrix4x4 *cbFramePhantom::GetImageToFrameMatrix()
+{
+  return m_imageToFrameMatrix;
+}
+
+//----------------------------------------------------------------------------
+double cbFramePhantom::MatrixError(vtkMatrix4x4 *result, vtkMatrix4x4 *truth,
+                                   bool useAP)
+{
+  vtkNew<vtkMatrix4x4> resultInverse;
+  vtkMatrix4x4::Invert(result, resultInverse);
+  vtkNew<vtkMatrix4x4> truthInverse;
+  vtkMatrix4x4::Invert(truth, truthInverse);
+
+  int numberOfSides = (useAP ? 4 : 2);
+  double sum = 0.0;
+  for (int side = 0; side < numberOfSides; side++) {
+    LeksellFiducial fiducial(static_cast<LeksellFiducial::Side>(side));
+    double corners[4][3];
+    fiducial.GetCornerOriginPoints(corners);
+    for (int i = 0; i < 4; i++) {
+      double p[4] = { corners[i][0], corners[i][1], corners[i][2], 1.0 };
+      double q[4];
+      resultInverse->MultiplyPoint(p, q);
+      truthInverse->MultiplyPoint(p, p);
+      sum += vtkMath::Distance2BetweenPoints(p, q);
+    }
+  }
+
+  return std::sqrt(sum/(4*numberOfSides));
+}
+
+//----------------------------------------------------------------------------
+double cbFramePhantom::Fiducials(const double f[3])
+{
+  double r = RodRadius + RodEdge;
+  double d2 = VTK_DOUBLE_MAX;
+  for (int i = 0; i < m_numberOfBars; i++) {
+    // quick rejection of rods that are far from the point
+    const double *a = m_bars[i][0];
+    const double *b = m_bars[i][1];
+    bool far = false;
+    for (int j = 0; j < 3 && !far; j++) {
+      double lo = (a[j] < b[j] ? a[j] : b[j]);
+      double hi = (a[j] < b[j] ? b[j] : a[j]);
+      far = (f[j] < lo - r || f[j] > hi + r);
+    }
+    if (!far) {
+      double e2 = SegmentDistance2(f, a, b);
+      d2 = (e2 < d2 ? e2 : d2);
+    }
+  }
+  if (d2 > r*r) {
+    return 0.0;
+  }
+
+  // a linear ramp across the edge of the rod
+  double a = (RodRadius + 0.5*RodEdge - std::sqrt(d2))/RodEdge;
+  return (a < 0.0 ? 0.0 : (a > 1.0 ? 1.0 : a));
+}
+
+//----------------------------------------------------------------------------
+double cbFramePhantom::Head(const double p[3])
+{
+  // an ellipsoidal head at the centre of the frame
+  static const double radii[3] = { 75.0, 95.0, 90.0 };
+  double s = 0.0;
+  for (int j = 0; j < 3; j++) {
+    s += (p[j]*p[j])/(radii[j]*radii[j]);
+  }
+
+  if (s > 1.0) {
+    return (m_ct ? -1000.0 : 0.0);
+  }
+  else if (s > 0.85) {
+    // scalp for MR, skull for CT
+    return (m_ct ? 1000.0 : 550.0);
+  }
+  return (m_ct ? 40.0 : 300.0);
+}
+
+//----------------------------------------------------------------------------
+void cbFramePhantom::Execute()
+{
+  // the rods, as the N shapes given by the LeksellFiducial corners
+  m_numberOfBars = 0;
+  int numberOfSides = (m_useAP ? 4 : 2);
+  for (int side = 0; side < numberOfSides; side++) {
+    LeksellFiducial fiducial(static_cast<LeksellFiducial::Side>(side));
+    double corners[4][3];
+    fiducial.GetCornerOriginPoints(corners);
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        m_bars[m_numberOfBars][0][j] = corners[i][j];
+        m_bars[m_numberOfBars][1][j] = corners[i+1][j];
+      }
+      m_numberOfBars++;
+    }
+  }
+
+  // frame coordinates increase to the left, anterior, and inferior,
+  // while patient coordinates increase to the left, posterior and superior
+  vtkNew<vtkTransform> frameToPatient;
+  frameToPatient->PostMultiply();
+  frameToPatient->Translate(-100.0, -100.0, -100.0);
+  frameToPatient->Scale(1.0, -1.0, -1.0);
+  frameToPatient->RotateX(m_angles[0]);
+  frameToPatient->RotateY(m_angles[1]);
+  frameToPatient->RotateZ(m_angles[2]);
+  frameToPatient->Translate(m_translation);
+
+  // the image is axial, with image coords equal to patient coords
+  m_patientMatrix->Identity();
+  vtkMatrix4x4::Invert(frameToPatient->GetMatrix(), m_imageToFrameMatrix);
+
+  // find the bounds of the fiducials in patient coordinates
+  double bounds[6] = {
+    VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX,
+    VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX,
+    VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  for (int i = 0; i < m_numberOfBars; i++) {
+    for (int e = 0; e < 2; e++) {
+      double p[3];
+      frameToPatient->TransformPoint(m_bars[i][e], p);
+      for (int j = 0; j < 3; j++) {
+        bounds[2*j] = (p[j] < bounds[2*j] ? p[j] : bounds[2*j]);
+        bounds[2*j+1] = (p[j] > bounds[2*j+1] ? p[j] : bounds[2*j+1]);
+      }
+    }
+  }
+
+  double spacing[3] = { m_pixelSpacing, m_pixelSpacing, m_sliceSpacing };
+  double origin[3];
+  int dims[3];
+  for (int j = 0; j < 3; j++) {
+    origin[j] = bounds[2*j] - FrameMargin;
+    dims[j] = static_cast<int>(std::ceil(
+      (bounds[2*j+1] - bounds[2*j] + 2*FrameMargin)/spacing[j])) + 1;
+  }
+
+  m_image->SetDimensions(dims);
+  m_image->SetSpacing(spacing);
+  m_image->SetOrigin(origin);
+  m_image->AllocateScalars(VTK_SHORT, 1);
+
+  double background = (m_ct ? -1000.0 : 0.0);
+  double contrast = (m_ct ? 3000.0 : 1000.0);
+  double noise = m_noiseLevel*contrast;
+
+  // each slice integrates the fiducials over the slice thickness
+  int subSlices = vtkMath::Round(m_sliceSpacing/m_pixelSpacing);
+  subSlices = (subSlices < 1 ? 1 : subSlices);
+
+  vtkMatrix4x4 *matrix = m_imageToFrameMatrix;
+  unsigned int seed = m_seed;
+  short *ptr = static_cast<short *>(m_image->GetScalarPointer());
+  for (int k = 0; k < dims[2]; k++) {
+    for (int j = 0; j < dims[1]; j++) {
+      for (int i = 0; i < dims[0]; i++) {
+        double p[4] = {
+          origin[0] + i*spacing[0],
+          origin[1] + j*spacing[1],
+          origin[2] + k*spacing[2],
+          1.0 };
+
+        double v = this->Head(p);
+
+        double rod = 0.0;
+        for (int s = 0; s < subSlices; s++) {
+          double q[4] = { p[0], p[1],
+            p[2] + ((s + 0.5)/subSlices - 0.5)*spacing[2], 1.0 };
+          matrix->MultiplyPoint(q, q);
+          rod += this->Fiducials(q);
+        }
+        rod /= subSlices;
+        v = v*(1.0 - rod) + (background + contrast)*rod;
+
+        // approximately gaussian noise, from a sum of uniform deviates
+        double r = 0.0;
+        for (int n = 0; n < 4; n++) {
+          seed = seed*1664525u + 1013904223u;
+          r += (seed >> 8)/16777216.0 - 0.5;
+        }
+        v += noise*r*std::sqrt(3.0);
+
+        v = (v < VTK_SHORT_MIN ? VTK_SHORT_MIN : v);
+        v = (v > VTK_SHORT_MAX ? VTK_SHORT_MAX : v);
+        *ptr++ = static_cast<short>(vtkMath::Round(v));
+      }
+    }
+  }
+
+  m_image->Modified();
+}
@@ -0,0 +1,148 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbFramePhantom.h
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+// .NAME cbFramePhantom - Make a synthetic image of a Leksell frame.
+// .SECTION Description
+// cbFramePhantom generates an axial MR-like or CT-like image of a head
+// that wears a Leksell frame, with the N-shaped fiducials described by
+// LeksellFiducial.  The frame can be given any rigid pose relative to
+// the image, and the slice spacing, pixel spacing and the noise level
+// can be set, so that the frame finder can be tested and benchmarked
+// against a known image-to-frame matrix without any patient data.
+// Partial volume effects are included by supersampling each slice.
+
+#ifndef CBFRAMEPHANTOM_H
+#define CBFRAMEPHANTOM_H
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+class vtkMatrix4x4;
+
+class cbFramePhantom
+{
+public:
+  static cbFramePhantom *New() {
+    return new cbFramePhantom; };
+  cbFramePhantom();
+  ~cbFramePhantom();
+
+  // Description:
+  // Generate a CT-like image instead of an MR-like image.
+  // The DEFAULT is MR.
+  void SetModalityToMR() { m_ct = false; }
+  void SetModalityToCT() { m_ct = true; }
+  bool GetModalityIsCT() { return m_ct; }
+
+  // Description:
+  // The in-plane pixel spacing and the slice spacing, in millimetres.
+  // The DEFAULT is 1.0 mm for both.
+  void SetPixelSpacing(double spacing) { m_pixelSpacing = spacing; }
+  double GetPixelSpacing() { return m_pixelSpacing; }
+  void SetSliceSpacing(double spacing) { m_sliceSpacing = spacing; }
+  double GetSliceSpacing() { return m_sliceSpacing; }
+
+  // Description:
+  // The standard deviation of the noise, as a fraction of the contrast
+  // between the fiducials and the background.  The DEFAULT is 0.0.
+  void SetNoiseLevel(double level) { m_noiseLevel = level; }
+  double GetNoiseLevel() { return m_noiseLevel; }
+
+  // Description:
+  // The seed for the noise, so that images can be reproduced.
+  void SetSeed(unsigned int seed) { m_seed = seed; }
+  unsigned int GetSeed() { return m_seed; }
+
+  // Description:
+  // Include the anterior and posterior fiducials, as well as the left
+  // and right fiducials.  The DEFAULT is off.
+  void SetUseAnteriorPosteriorFiducials(bool use) { m_useAP = use; }
+  bool GetUseAnteriorPosteriorFiducials() { return m_useAP; }
+
+  // Description:
+  // The pose of the frame, as rotations in degrees about the x, y and z
+  // axes of the frame centre, followed by a translation in millimetres.
+  // The DEFAULT is no rotation and no translation, which puts the frame
+  // centre at the patient origin with the frame axes aligned with the
+  // patient axes.
+  void SetPose(const double angles[3], const double translation[3]);
+
+  // Description:
+  // Generate the image.
+  void Execute();
+
+  // Description:
+  // Get the image, the DICOM patient matrix for the image, and the
+  // true image-to-frame matrix.
+  vtkImageData *GetOutput();
+  vtkMatrix4x4 *GetPatientMatrix();
+  vtkMatrix4x4 *GetImageToFrameMatrix();
+
+  // Description:
+  // Compare an image-to-frame matrix with the true matrix.  The result
+  // is the RMS distance, in millimetres, between the fiducial corners
+  // as mapped into the image by each of the two matrices.
+  static double MatrixError(vtkMatrix4x4 *result, vtkMatrix4x4 *truth,
+                            bool useAP);
+
+protected:
+  // Description:
+  // Get the fiducial intensity at a point in frame coordinates.
+  double Fiducials(const double f[3]);
+
+  // Description:
+  // Get the head intensity at a point in patient coordinates.
+  double Head(const double p[3]);
+
+private:
+  cbFramePhantom(const cbFramePhantom&); // Not implemented.
+  void operator=(const cbFramePhantom&); // Not implemented.
+
+  vtkSmartPointer<vtkImageData> m_image;
+  vtkSmartPointer<vtkMatrix4x4> m_patientMatrix;
+  vtkSmartPointer<vtkMatrix4x4> m_imageToFrameMatrix;
+  bool m_ct;
+  bool m_useAP;
+  double m_pixelSpacing;
+  double m_sliceSpacing;
+  double m_noiseLevel;
+  unsigned int m_seed;
+  double m_angles[3];
+  double m_translation[3];
+  double m_bars[12][2][3];
+  int m_numberOfBars;
+};
+
+#endif // CBFRAMEPHANTOM_H
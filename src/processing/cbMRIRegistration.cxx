@@ -69,6 +69,7 @@
  =========================================================================*/
 
 #include "cbMRIRegistration.h"
+#include "cbCancellationToken.h"
 //VTK includes
 #include <vtkSmartPointer.h>
 #include <vtkMath.h>
@@ -90,11 +91,13 @@
 #include <vtkImageProperty.h>
 #include <vtkTimerLog.h>
 #include <vtkErrorCode.h>
+#include <vtkSMPTools.h>
 //AIRS includes
 #include <vtkImageRegistration.h>
 #include <vtkProgressAccumulator.h>
 
 #include <iostream>
+#include <vector>
 //----------------------------------------------------------------------------
 cbMRIRegistration::cbMRIRegistration()
 {
@@ -104,6 +107,8 @@ cbMRIRegistration::cbMRIRegistration()
   m_targetMatrix = NULL;
   m_renderWindow = NULL;
   m_progressAccumulate = NULL;
+  m_cancellationToken = NULL;
+  m_logStream = &std::cout;
   m_modifySourceMatrix = true;
   m_registrationMethod = MUTUAL_INFORMATION;
   m_registration = NULL;
@@ -113,7 +118,15 @@ cbMRIRegistration::cbMRIRegistration()
   m_targetBlurKernel = NULL;
   m_registrationInitialized = false;
   m_transformTolerance = 0.1;
+  m_numberOfStarts = 1;
+  m_startAngle = 20.0;
   m_funcEvals = 0;
+  m_levelActive = false;
+  m_levelStartTime = 0.0;
+  m_multiStartEvals = 0;
+  m_multiStartBestEvals = 0;
+  m_multiStartMetric = 0.0;
+  m_levelConverged = false;
 }
 
 //----------------------------------------------------------------------------
@@ -157,12 +170,24 @@ cbMRIRegistration::~cbMRIRegistration()
 //----------------------------------------------------------------------------
 void cbMRIRegistration::SetRenderWindow(vtkRenderWindow *renderwindow)
 {
+  if (renderwindow) {
+    renderwindow->Register(NULL);
+  }
+  if (m_renderWindow) {
+    m_renderWindow->Delete();
+  }
   m_renderWindow = renderwindow;
 }
 
 //----------------------------------------------------------------------------
 void cbMRIRegistration::SetInputSource(vtkImageData *inputSource)
 {
+  if (inputSource) {
+    inputSource->Register(NULL);
+  }
+  if (m_sourceImage) {
+    m_sourceImage->Delete();
+  }
   m_sourceImage = inputSource;
 }
 
@@ -175,6 +200,12 @@ vtkImageData *cbMRIRegistration::GetInputSource()
 //----------------------------------------------------------------------------
 void cbMRIRegistration::SetInputTarget(vtkImageData *inputTarget)
 {
+  if (inputTarget) {
+    inputTarget->Register(NULL);
+  }
+  if (m_targetImage) {
+    m_targetImage->Delete();
+  }
   m_targetImage = inputTarget;
 }
 
@@ -187,6 +218,12 @@ vtkImageData *cbMRIRegistration::GetInputTarget()
 //----------------------------------------------------------------------------
 void cbMRIRegistration::SetInputSourceMatrix(vtkMatrix4x4 *inputSourceMatrix)
 {
+  if (inputSourceMatrix) {
+    inputSourceMatrix->Register(NULL);
+  }
+  if (m_sourceMatrix) {
+    m_sourceMatrix->Delete();
+  }
   m_sourceMatrix = inputSourceMatrix;
 }
 
@@ -199,6 +236,12 @@ vtkMatrix4x4 *cbMRIRegistration::GetInputSourceMatrix()
 //----------------------------------------------------------------------------
 void cbMRIRegistration::SetInputTargetMatrix(vtkMatrix4x4 *inputTargetMatrix)
 {
+  if (inputTargetMatrix) {
+    inputTargetMatrix->Register(NULL);
+  }
+  if (m_targetMatrix) {
+    m_targetMatrix->Delete();
+  }
   m_targetMatrix = inputTargetMatrix;
 }
 
@@ -244,33 +287,59 @@ vtkProgressAccumulator *cbMRIRegistration::GetProgressAccumulator()
   return m_progressAccumulate;
 }
 
+//----------------------------------------------------------------------------
+void cbMRIRegistration::SetCancellationToken(cbCancellationToken *token)
+{
+  m_cancellationToken = token;
+}
+
+//----------------------------------------------------------------------------
+cbCancellationToken *cbMRIRegistration::GetCancellationToken()
+{
+  return m_cancellationToken;
+}
+
+//----------------------------------------------------------------------------
+bool cbMRIRegistration::IsCancelled()
+{
+  return (m_cancellationToken && m_cancellationToken->IsCancelled());
+}
+
+//----------------------------------------------------------------------------
+void cbMRIRegistration::SetNumberOfStarts(int n)
+{
+  m_numberOfStarts = (n < 1 ? 1 : (n > 7 ? 7 : n));
+}
+
+//----------------------------------------------------------------------------
+void cbMRIRegistration::SetLogStream(std::ostream *os)
+{
+  m_logStream = (os ? os : &std::cout);
+}
+
 //----------------------------------------------------------------------------
 int cbMRIRegistration::Execute()
 {
   double initialBlurFactor = 4.0;
   double blurFactor = initialBlurFactor;
 
-  this->Initialize();
-
-  // make a timer
-  vtkSmartPointer<vtkTimerLog> timer =
-  vtkSmartPointer<vtkTimerLog>::New();
-  double startTime = timer->GetUniversalTime();
-  double lastTime = startTime;
+  if (!this->Initialize()) {
+    return 0;
+  }
 
   // do multi-level registration
   for (;;)
   {
-    this->StartLevel(blurFactor);
+    if (!this->StartLevel(blurFactor)) {
+      break;
+    }
 
     // iterate until this level is done
     while (this->Iterate()) {}
 
-    double newTime = timer->GetUniversalTime();
-    std::cout << "blur " << blurFactor << " took "
-         << (newTime - lastTime) << "s and "
-         << m_registration->GetNumberOfEvaluations() << " evaluations" << endl;
-    lastTime = newTime;
+    if (this->IsCancelled()) {
+      break;
+    }
 
     // prepare for next iteration
     blurFactor /= 2.0;
@@ -282,7 +351,19 @@ int cbMRIRegistration::Execute()
 
   this->Finish();
 
-  std::cout << "registration took " << (lastTime - startTime) << "s" << endl;
+  if (this->IsCancelled()) {
+    *m_logStream << "registration cancelled" << endl;
+    return 0;
+  }
+
+  double totalTime = 0.0;
+  for (size_t i = 0; i < m_levelStats.size(); i++)
+  {
+    totalTime += m_levelStats[i].WallTime;
+  }
+
+  this->PrintStatistics(*m_logStream);
+  *m_logStream << "registration took " << totalTime << "s" << endl;
 
   return 1;
 }
@@ -293,15 +374,11 @@ int cbMRIRegistration::Initialize()
   if (m_sourceImage == NULL || m_targetImage == NULL ||
       m_sourceMatrix == NULL || m_targetMatrix == NULL)
   {
-    std::cout << "Execute: Input source image & matrix and"
-            "target image & matrix are not set " << endl;
+    *m_logStream << "Execute: Input source image & matrix and"
+                    "target image & matrix are not set " << endl;
     return 0;
   }
 
-  // parameters for registration
-  int interpolatorType = vtkImageRegistration::Rigid;
-  int numberOfBins = 64; // for Mattes' mutual information
-
   // get information about the images
   double targetSpacing[3], sourceSpacing[3];
   m_targetImage->GetSpacing(targetSpacing);
@@ -351,6 +428,11 @@ int cbMRIRegistration::Initialize()
     m_progressAccumulate->RegisterFilter(m_targetBlur,0.07f);
   }
 
+  if (m_cancellationToken) {
+    m_cancellationToken->Watch(m_sourceBlur);
+    m_cancellationToken->Watch(m_targetBlur);
+  }
+
   // set up the registration
   m_registration = vtkImageRegistration::New();
   m_registration->SetTargetImageInputConnection(m_targetBlur->GetOutputPort());
@@ -361,22 +443,138 @@ int cbMRIRegistration::Initialize()
     m_progressAccumulate->RegisterFilter(m_registration,0.05f);
   }
 
-  m_registration->SetTransformTypeToRigid();
+  this->SetupRegistration(m_registration);
+
+  m_registrationInitialized = false;
+  m_funcEvals = 0;
+  m_levelStats.clear();
+  m_levelActive = false;
+
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+void cbMRIRegistration::SetupRegistration(vtkImageRegistration *registration)
+{
+  // parameters for registration
+  int interpolatorType = vtkImageRegistration::Rigid;
+  int numberOfBins = 64; // for Mattes' mutual information
+
+  registration->SetTransformTypeToRigid();
 
   if (m_registrationMethod == MUTUAL_INFORMATION) {
-    m_registration->SetMetricTypeToNormalizedMutualInformation();
+    registration->SetMetricTypeToNormalizedMutualInformation();
   }
   else if (m_registrationMethod == CROSS_CORRELATION) {
-    m_registration->SetMetricTypeToNormalizedCrossCorrelation();
+    registration->SetMetricTypeToNormalizedCrossCorrelation();
   }
-  m_registration->SetInterpolatorType(interpolatorType);
-  m_registration->SetJointHistogramSize(numberOfBins,numberOfBins);
-  m_registration->SetCostTolerance(1e-4);
-  m_registration->SetTransformTolerance(m_transformTolerance);
-  m_registration->SetMaximumNumberOfIterations(500);
+  registration->SetInterpolatorType(interpolatorType);
+  registration->SetJointHistogramSize(numberOfBins,numberOfBins);
+  registration->SetCostTolerance(1e-4);
+  registration->SetTransformTolerance(m_transformTolerance);
+  registration->SetMaximumNumberOfIterations(500);
+}
 
-  m_registrationInitialized = false;
-  m_funcEvals = 0;
+//----------------------------------------------------------------------------
+int cbMRIRegistration::MultiStart(vtkMatrix4x4 *matrix)
+{
+  // let the centered initializer compute the base pose
+  m_registration->Initialize(matrix);
+  vtkSmartPointer<vtkMatrix4x4> baseMatrix =
+    vtkSmartPointer<vtkMatrix4x4>::New();
+  baseMatrix->DeepCopy(m_registration->GetTransform()->GetMatrix());
+
+  // rotate around the center of the source image, the base matrix
+  // maps target coordinates to source coordinates, so the rotation
+  // must be applied after it
+  double bounds[6], center[3];
+  m_sourceBlur->GetOutput()->GetBounds(bounds);
+  for (int j = 0; j < 3; j++)
+  {
+    center[j] = 0.5*(bounds[2*j] + bounds[2*j+1]);
+  }
+
+  // the starting poses: centered, then +/- rotations around x, y, z
+  static const double axes[7][4] = {
+    {  0.0, 1.0, 0.0, 0.0 },
+    {  1.0, 1.0, 0.0, 0.0 },
+    { -1.0, 1.0, 0.0, 0.0 },
+    {  1.0, 0.0, 1.0, 0.0 },
+    { -1.0, 0.0, 1.0, 0.0 },
+    {  1.0, 0.0, 0.0, 1.0 },
+    { -1.0, 0.0, 0.0, 1.0 }
+  };
+
+  int n = m_numberOfStarts;
+  std::vector<vtkSmartPointer<vtkImageRegistration> > starts(n);
+  std::vector<double> metricValues(n);
+  std::vector<int> evaluations(n);
+
+  for (int i = 0; i < n; i++)
+  {
+    vtkSmartPointer<vtkTransform> pose =
+      vtkSmartPointer<vtkTransform>::New();
+    pose->PostMultiply();
+    pose->Concatenate(baseMatrix);
+    pose->Translate(-center[0], -center[1], -center[2]);
+    pose->RotateWXYZ(axes[i][0]*m_startAngle,
+                     axes[i][1], axes[i][2], axes[i][3]);
+    pose->Translate(center[0], center[1], center[2]);
+
+    // each start gets its own copy of the image headers, so that
+    // the threads do not share any pipeline information
+    vtkSmartPointer<vtkImageData> sourceImage =
+      vtkSmartPointer<vtkImageData>::New();
+    sourceImage->ShallowCopy(m_sourceBlur->GetOutput());
+    vtkSmartPointer<vtkImageData> targetImage =
+      vtkSmartPointer<vtkImageData>::New();
+    targetImage->ShallowCopy(m_targetBlur->GetOutput());
+
+    starts[i] = vtkSmartPointer<vtkImageRegistration>::New();
+    starts[i]->SetSourceImage(sourceImage);
+    starts[i]->SetTargetImage(targetImage);
+    this->SetupRegistration(starts[i]);
+    starts[i]->SetTransformTolerance(m_registration->GetTransformTolerance());
+    starts[i]->SetInitializerTypeToNone();
+    starts[i]->Initialize(pose->GetMatrix());
+  }
+
+  // run the starts concurrently
+  vtkSMPTools::For(0, n, 1, [&](vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType i = begin; i < end; i++)
+    {
+      while (!this->IsCancelled() && starts[i]->Iterate()) {}
+      metricValues[i] = starts[i]->GetMetricValue();
+      evaluations[i] = starts[i]->GetNumberOfEvaluations();
+    }
+  });
+
+  if (this->IsCancelled()) {
+    return 0;
+  }
+
+  // the optimizer minimizes the metric value, so lowest is best
+  int best = 0;
+  int totalEvals = 0;
+  for (int i = 0; i < n; i++)
+  {
+    totalEvals += evaluations[i];
+    *m_logStream << "start " << i << " metric " << metricValues[i]
+                 << " after " << evaluations[i] << " evaluations" << endl;
+    if (metricValues[i] < metricValues[best])
+    {
+      best = i;
+    }
+  }
+
+  // the best start has converged, so its result is the result
+  // for the level, and the other starts are counted separately
+  m_multiStartBestEvals = evaluations[best];
+  m_multiStartEvals = totalEvals - evaluations[best];
+  m_multiStartMetric = metricValues[best];
+
+  matrix->DeepCopy(starts[best]->GetTransform()->GetMatrix());
 
   return 1;
 }
@@ -384,6 +582,25 @@ int cbMRIRegistration::Initialize()
 //----------------------------------------------------------------------------
 int cbMRIRegistration::StartLevel(double blurFactor)
 {
+  this->EndLevel();
+  m_levelConverged = false;
+
+  if (this->IsCancelled()) {
+    return 0;
+  }
+
+  LevelStatistics stats;
+  stats.BlurFactor = blurFactor;
+  stats.WallTime = 0.0;
+  stats.MetricTime = 0.0;
+  stats.MultiStartTime = 0.0;
+  stats.NumberOfEvaluations = 0;
+  stats.MultiStartEvaluations = 0;
+  stats.TranslationDelta = 0.0;
+  stats.RotationDelta = 0.0;
+
+  double startTime = vtkTimerLog::GetUniversalTime();
+
   // get information about the images
   double targetSpacing[3], sourceSpacing[3];
   m_targetImage->GetSpacing(targetSpacing);
@@ -447,6 +664,13 @@ int cbMRIRegistration::StartLevel(double blurFactor)
     m_targetBlur->Update();
   }
 
+  // the resize filters will have aborted if cancelled
+  if (this->IsCancelled()) {
+    return 0;
+  }
+
+  stats.ResizeTime = vtkTimerLog::GetUniversalTime() - startTime;
+
   // get the initial transformation
   vtkSmartPointer<vtkMatrix4x4> matrix =
     vtkSmartPointer<vtkMatrix4x4>::New();
@@ -462,35 +686,136 @@ int cbMRIRegistration::StartLevel(double blurFactor)
     matrix->DeepCopy(m_targetMatrix);
     matrix->Invert();
     vtkMatrix4x4::Multiply4x4(matrix, m_sourceMatrix, matrix);
+
+    if (m_numberOfStarts > 1)
+    {
+      // choose the best of several starting poses, each of which
+      // has already been run to convergence at this level, so the
+      // best pose is kept as the result of the level
+      vtkMatrix4x4::DeepCopy(m_levelStartMatrix, matrix);
+      double multiStartTime = vtkTimerLog::GetUniversalTime();
+      if (!this->MultiStart(matrix)) {
+        return 0;
+      }
+      m_registration->SetInitializerTypeToNone();
+      stats.MultiStartTime =
+        vtkTimerLog::GetUniversalTime() - multiStartTime;
+      stats.NumberOfEvaluations = m_multiStartBestEvals;
+      stats.MultiStartEvaluations = m_multiStartEvals;
+      stats.MetricValues.push_back(m_multiStartMetric);
+      m_levelConverged = true;
+    }
   }
 
   m_registration->Initialize(matrix);
   m_registrationInitialized = true;
   m_funcEvals = 0; // start fresh
 
+  if (m_levelConverged)
+  {
+    // nothing is left to iterate at this level
+    m_funcEvals = m_multiStartBestEvals;
+    this->UpdateModifiedMatrix();
+  }
+  else
+  {
+    // the starting point, for measuring how far this level moves
+    vtkMatrix4x4::DeepCopy(m_levelStartMatrix,
+                           m_registration->GetTransform()->GetMatrix());
+  }
+  m_levelStartTime = startTime;
+  m_levelStats.push_back(stats);
+  m_levelActive = true;
+
   return 1;
 }
 
 //----------------------------------------------------------------------------
-int cbMRIRegistration::Iterate()
+void cbMRIRegistration::EndLevel()
 {
-  if (m_registration->Iterate())
+  if (!m_levelActive) {
+    return;
+  }
+  m_levelActive = false;
+
+  LevelStatistics& stats = m_levelStats.back();
+  stats.WallTime = vtkTimerLog::GetUniversalTime() - m_levelStartTime;
+
+  double endMatrix[16];
+  vtkMatrix4x4::DeepCopy(endMatrix,
+                         m_registration->GetTransform()->GetMatrix());
+
+  // the translation delta is the change in the translation column,
+  // the rotation delta is the angle of the relative rotation
+  double t = 0.0;
+  double trace = 0.0;
+  for (int i = 0; i < 3; i++)
   {
-    //m_registration->UpdateRegistration();
-    // will iterate until convergence or failure
-    if (m_modifySourceMatrix) {
-      vtkMatrix4x4::Multiply4x4(m_targetMatrix,
-                                m_registration->GetTransform()->GetMatrix(),
-                                m_sourceMatrix);
-      m_sourceMatrix->Modified();
+    double d = endMatrix[4*i + 3] - m_levelStartMatrix[4*i + 3];
+    t += d*d;
+    for (int j = 0; j < 3; j++)
+    {
+      trace += endMatrix[4*i + j]*m_levelStartMatrix[4*i + j];
+    }
+  }
+  double c = 0.5*(trace - 1.0);
+  c = (c > 1.0 ? 1.0 : (c < -1.0 ? -1.0 : c));
+  stats.TranslationDelta = sqrt(t);
+  stats.RotationDelta = vtkMath::DegreesFromRadians(acos(c));
+}
+
+//----------------------------------------------------------------------------
+void cbMRIRegistration::PrintStatistics(std::ostream& os)
+{
+  for (size_t i = 0; i < m_levelStats.size(); i++)
+  {
+    const LevelStatistics& stats = m_levelStats[i];
+    os << "level " << (i + 1) << " blur " << stats.BlurFactor
+       << ": " << stats.WallTime << "s (resize " << stats.ResizeTime
+       << "s, metric " << stats.MetricTime << "s";
+    if (stats.MultiStartTime > 0)
+    {
+      os << ", multi-start " << stats.MultiStartTime << "s";
     }
-    else {
-      vtkMatrix4x4::Multiply4x4(m_sourceMatrix,
-                                m_registration->GetTransform()->GetLinearInverse()->GetMatrix(),
-                                m_targetMatrix);
-      m_targetMatrix->Modified();
+    os << "), "
+       << stats.NumberOfEvaluations << " evaluations";
+    if (stats.MultiStartEvaluations > 0)
+    {
+      os << " + " << stats.MultiStartEvaluations << " multi-start";
+    }
+    if (!stats.MetricValues.empty())
+    {
+      os << ", metric " << stats.MetricValues.front()
+         << " -> " << stats.MetricValues.back();
     }
+    os << ", moved " << stats.TranslationDelta << "mm "
+       << stats.RotationDelta << "deg" << endl;
+  }
+}
 
+//----------------------------------------------------------------------------
+int cbMRIRegistration::Iterate()
+{
+  if (this->IsCancelled() || m_levelConverged) {
+    return 0;
+  }
+
+  double startTime = vtkTimerLog::GetUniversalTime();
+  int more = m_registration->Iterate();
+
+  if (m_levelActive)
+  {
+    LevelStatistics& stats = m_levelStats.back();
+    stats.MetricTime += vtkTimerLog::GetUniversalTime() - startTime;
+    stats.NumberOfEvaluations = m_registration->GetNumberOfEvaluations();
+    stats.MetricValues.push_back(m_registration->GetMetricValue());
+  }
+
+  if (more)
+  {
+    //m_registration->UpdateRegistration();
+    // will iterate until convergence or failure
+    this->UpdateModifiedMatrix();
 
     if (m_renderWindow) {
       m_renderWindow->Render();
@@ -504,9 +829,34 @@ int cbMRIRegistration::Iterate()
   return 0;
 }
 
+//----------------------------------------------------------------------------
+void cbMRIRegistration::UpdateModifiedMatrix()
+{
+  if (m_modifySourceMatrix) {
+    vtkMatrix4x4::Multiply4x4(m_targetMatrix,
+                              m_registration->GetTransform()->GetMatrix(),
+                              m_sourceMatrix);
+    m_sourceMatrix->Modified();
+  }
+  else {
+    vtkMatrix4x4::Multiply4x4(m_sourceMatrix,
+                              m_registration->GetTransform()->GetLinearInverse()->GetMatrix(),
+                              m_targetMatrix);
+    m_targetMatrix->Modified();
+  }
+}
+
 //----------------------------------------------------------------------------
 int cbMRIRegistration::Finish()
 {
+  // release the blurred images and the registration, this is also
+  // how the memory is reclaimed after the registration is cancelled
+  if (m_registration == NULL) {
+    return 0;
+  }
+
+  this->EndLevel();
+
   m_sourceBlur->Delete();
   m_sourceBlur = NULL;
   m_sourceBlurKernel->Delete();
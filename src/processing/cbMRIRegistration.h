@@ -75,6 +75,9 @@
 #ifndef CBMRIREGISTRATION_H
 #define CBMRIREGISTRATION_H
 
+#include <iosfwd>
+#include <vector>
+
 class vtkImageData;
 class vtkRenderWindow;
 class vtkImageData;
@@ -83,6 +86,7 @@ class vtkProgressAccumulator;
 class vtkImageRegistration;
 class vtkImageResize;
 class vtkImageSincInterpolator;
+class cbCancellationToken;
 
 class cbMRIRegistration
 {
@@ -95,6 +99,7 @@ public:
   // Description:
   // Input the image uses as the source image and target image.
   // Input the 4x4 matrix used by source image and target image.
+  // The registration keeps a reference to each input.
   void SetInputSource(vtkImageData *inputSource);
   vtkImageData *GetInputSource();
   void SetInputTarget(vtkImageData *inputTarget);
@@ -129,6 +134,43 @@ public:
   void SetProgressAccumulator(vtkProgressAccumulator *progressAccumulate);
   vtkProgressAccumulator *GetProgressAccumulator();
 
+  // Description:
+  // Provide a token that can be used to stop the registration early.
+  // The token is checked before every iteration, and the resize filters
+  // that blur the images at the start of each level are aborted through
+  // it.  Once cancelled, Iterate() and StartLevel() will return 0.
+  void SetCancellationToken(cbCancellationToken *token);
+  cbCancellationToken *GetCancellationToken();
+
+  // Description:
+  // Check whether the registration was stopped by the cancellation token.
+  bool IsCancelled();
+
+  // Description:
+  // Set the number of starting poses to try at the first level.
+  // When this is greater than one, the first level is run concurrently
+  // from the centered pose and from poses rotated by the start angle
+  // around each axis of the source image, and only the best-scoring
+  // result is refined at the following levels.  This makes the
+  // registration robust to large differences in patient positioning.
+  // The DEFAULT is 1, and the maximum is 7.
+  void SetNumberOfStarts(int n);
+  int GetNumberOfStarts() { return m_numberOfStarts; }
+
+  // Description:
+  // Set the rotation, in degrees, for the multi-start poses.
+  // The DEFAULT is 20 degrees.
+  void SetStartAngle(double angle) { m_startAngle = angle; }
+  double GetStartAngle() { return m_startAngle; }
+
+  // Description:
+  // Set the stream that the progress messages are written to, such as
+  // the results of the multi-start search and the final statistics.
+  // The stream is not owned by this object.  Setting it to NULL will
+  // restore the DEFAULT, which is std::cout.
+  void SetLogStream(std::ostream *os);
+  std::ostream *GetLogStream() { return m_logStream; }
+
   // Description:
   // Execute the image registration
   int Execute();
@@ -154,6 +196,40 @@ public:
   // Get the number of function evaluations thus far
   int GetNumberOfEvaluations() { return m_funcEvals; }
 
+  // Description:
+  // Statistics that are collected for each level of the registration.
+  // All times are wall-clock seconds.  The ResizeTime is the time spent
+  // blurring and resampling the images, and the MetricTime is the time
+  // spent in the optimizer, which is dominated by metric evaluations.
+  // The MultiStartTime is the time taken by the concurrent starts, it
+  // is only nonzero for the first level when there are several starts.
+  // The MetricValues hold the metric after each iteration, and the
+  // deltas give how far the transform moved during the level.
+  struct LevelStatistics
+  {
+    double BlurFactor;
+    double WallTime;
+    double ResizeTime;
+    double MetricTime;
+    double MultiStartTime;
+    int NumberOfEvaluations;
+    int MultiStartEvaluations;
+    std::vector<double> MetricValues;
+    double TranslationDelta;
+    double RotationDelta;
+  };
+
+  // Description:
+  // Get the statistics for the levels that have been run.  These are
+  // still available after Finish(), until the next Initialize().
+  int GetNumberOfLevels() { return static_cast<int>(m_levelStats.size()); }
+  const LevelStatistics& GetLevelStatistics(int level) {
+    return m_levelStats[level]; }
+
+  // Description:
+  // Print the statistics, with one line per level.
+  void PrintStatistics(std::ostream& os);
+
   enum RegistrationMethod {
     MUTUAL_INFORMATION = 1,
     CROSS_CORRELATION = 2,
@@ -161,6 +237,23 @@ public:
 
 protected:
 
+  // Description:
+  // Apply the metric and optimizer settings to a registration.
+  void SetupRegistration(vtkImageRegistration *registration);
+
+  // Description:
+  // Run the current level from several starting poses in parallel,
+  // and replace the given matrix with the best result.
+  int MultiStart(vtkMatrix4x4 *matrix);
+
+  // Description:
+  // Apply the current transform to the matrix that is being modified.
+  void UpdateModifiedMatrix();
+
+  // Description:
+  // Complete the statistics for the level that was last started.
+  void EndLevel();
+
 private:
   vtkImageData *m_sourceImage;
   vtkImageData *m_targetImage;
@@ -168,6 +261,8 @@ private:
   vtkMatrix4x4 *m_targetMatrix;
   vtkRenderWindow *m_renderWindow;
   vtkProgressAccumulator *m_progressAccumulate;
+  cbCancellationToken *m_cancellationToken;
+  std::ostream *m_logStream;
   bool m_modifySourceMatrix;
   int m_registrationMethod;
 
@@ -177,8 +272,19 @@ private:
   vtkImageSincInterpolator *m_sourceBlurKernel;
   vtkImageSincInterpolator *m_targetBlurKernel;
   double m_transformTolerance;
+  int m_numberOfStarts;
+  double m_startAngle;
   int m_funcEvals;
   bool m_registrationInitialized;
+
+  std::vector<LevelStatistics> m_levelStats;
+  bool m_levelActive;
+  double m_levelStartTime;
+  double m_levelStartMatrix[16];
+  int m_multiStartEvals;
+  int m_multiStartBestEvals;
+  double m_multiStartMetric;
+  bool m_levelConverged;
 };
 
 #endif // CBMRIREGISTRATION_H
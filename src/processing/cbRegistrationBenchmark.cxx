@@ -0,0 +1,532 @@
+/*=========================================================================
+  Program: Cerebra
+  Module:  cbRegistrationBenchmark.cxx
+
+  Copyright (c) 2026 Calgary Image Processing and Analysis Centre
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+
+  * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+
+  * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+
+  * Neither the name of the Calgary Image Processing and Analysis Centre
+    (CIPAC), the University of Calgary, nor the names of any authors nor
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+=========================================================================*/
+// .NAME cbRegistrationBenchmark - Measure the speed and accuracy of registration.
+// .SECTION Description
+// This program runs cbMRIRegistration on image pairs with known rigid
+// misalignments, under each metric and each multi-resolution schedule,
+// and writes one JSON object per run (JSON Lines) with the wall time,
+// the per-level statistics from cbMRIRegistration::GetLevelStatistics()
+// and the residual error of the result.
+//
+// By default, synthetic MR-like and CT-like head phantoms are generated.
+// With --pairs, every "<case>_primary.nii.gz" in the directory is paired
+// with "<case>_secondary.nii.gz", which is how Tactics saves a plan.
+// Real pairs are assumed to be aligned by their matrices already, and
+// are misaligned by the same known offsets as the synthetic pairs.
+//
+// Usage: cbRegistrationBenchmark [--pairs dir] [--output file]
+//                                [--starts n]
+//
+// Use --output to keep the results separate from the messages that
+// cbMRIRegistration prints to the console.
+
+#include "cbMRIRegistration.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkMath.h>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkTransform.h>
+#include <vtkTimerLog.h>
+#include <vtkDirectory.h>
+#include <vtkNIFTIReader.h>
+#include <vtkDICOMToRAS.h>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+//----------------------------------------------------------------------------
+// A known rigid offset: rotations (degrees) and translation (mm)
+struct Offset
+{
+  double Rotation[3];
+  double Translation[3];
+};
+
+const Offset Offsets[] = {
+  { {  5.0,  0.0, 0.0 }, {  3.0, -2.0,  4.0 } },
+  { {  0.0, 10.0, 0.0 }, { -6.0,  4.0,  0.0 } },
+  { { 15.0,  0.0, 5.0 }, {  0.0,  8.0, -5.0 } },
+  { { 25.0,  0.0, 0.0 }, {  5.0,  5.0,  5.0 } }
+};
+
+//----------------------------------------------------------------------------
+// A multi-resolution schedule, as a list of blur factors
+struct Schedule
+{
+  const char *Name;
+  int NumberOfLevels;
+  double BlurFactors[3];
+};
+
+const Schedule Schedules[] = {
+  { "4-2-1", 3, { 4.0, 2.0, 1.0 } },
+  { "4-1",   2, { 4.0, 1.0, 0.0 } },
+  { "2-1",   2, { 2.0, 1.0, 0.0 } }
+};
+
+//----------------------------------------------------------------------------
+// A pair of images, where the source matrix is the ground truth
+struct ImagePair
+{
+  std::string Name;
+  vtkSmartPointer<vtkImageData> Target;
+  vtkSmartPointer<vtkMatrix4x4> TargetMatrix;
+  vtkSmartPointer<vtkImageData> Source;
+  vtkSmartPointer<vtkMatrix4x4> SourceMatrix;
+};
+
+//----------------------------------------------------------------------------
+void OffsetToMatrix(const Offset& offset, vtkMatrix4x4 *matrix)
+{
+  vtkSmartPointer<vtkTransform> transform =
+    vtkSmartPointer<vtkTransform>::New();
+  transform->PostMultiply();
+  transform->RotateX(offset.Rotation[0]);
+  transform->RotateY(offset.Rotation[1]);
+  transform->RotateZ(offset.Rotation[2]);
+  transform->Translate(offset.Translation);
+  matrix->DeepCopy(transform->GetMatrix());
+}
+
+//----------------------------------------------------------------------------
+// Test whether a point is inside an ellipsoid
+bool InEllipsoid(const double p[3], const double c[3], const double r[3],
+                 double scale = 1.0)
+{
+  double d = 0.0;
+  for (int j = 0; j < 3; j++)
+  {
+    double t = (p[j] - c[j])/(r[j]*scale);
+    d += t*t;
+  }
+  return (d <= 1.0);
+}
+
+//----------------------------------------------------------------------------
+// Evaluate the head phantom at a point in patient coordinates, giving
+// either MR-like (T1) or CT-like (Hounsfield) intensities
+double Phantom(const double p[3], bool ct)
+{
+  static const double head[3] = { 0.0, 0.0, 0.0 };
+  static const double headRadii[3] = { 72.0, 90.0, 70.0 };
+  static const double ventricles[2][3] = {
+    { -12.0, 5.0, 10.0 }, { 12.0, 5.0, 10.0 } };
+  static const double ventricleRadii[3] = { 6.0, 20.0, 8.0 };
+  static const double eyes[2][3] = {
+    { -30.0, -80.0, -30.0 }, { 30.0, -80.0, -30.0 } };
+  static const double eyeRadii[3] = { 12.0, 12.0, 12.0 };
+
+  for (int i = 0; i < 2; i++)
+  {
+    if (InEllipsoid(p, eyes[i], eyeRadii))
+    {
+      return (ct ? 10.0 : 250.0);
+    }
+  }
+  if (!InEllipsoid(p, head, headRadii))
+  {
+    return (ct ? -1000.0 : 0.0);
+  }
+  if (!InEllipsoid(p, head, headRadii, 0.95))
+  {
+    // scalp
+    return (ct ? 40.0 : 600.0);
+  }
+  if (!InEllipsoid(p, head, headRadii, 0.88))
+  {
+    // skull
+    return (ct ? 1200.0 : 100.0);
+  }
+  for (int i = 0; i < 2; i++)
+  {
+    if (InEllipsoid(p, ventricles[i], ventricleRadii))
+    {
+      return (ct ? 5.0 : 100.0);
+    }
+  }
+  if (InEllipsoid(p, head, headRadii, 0.6))
+  {
+    // white matter
+    return (ct ? 30.0 : 550.0);
+  }
+  // gray matter
+  return (ct ? 38.0 : 400.0);
+}
+
+//----------------------------------------------------------------------------
+// Sample the phantom onto an image grid centered at the origin, where
+// the phantom is moved by the given matrix before it is sampled
+void MakePhantomImage(vtkImageData *image, const int dims[3],
+                      const double spacing[3], vtkMatrix4x4 *matrix,
+                      bool ct)
+{
+  double origin[3];
+  for (int j = 0; j < 3; j++)
+  {
+    origin[j] = -0.5*(dims[j] - 1)*spacing[j];
+  }
+
+  image->SetDimensions(dims[0], dims[1], dims[2]);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->AllocateScalars(VTK_SHORT, 1);
+
+  // a simple deterministic noise generator
+  unsigned int seed = (ct ? 1234u : 5678u);
+  double noise = (ct ? 8.0 : 15.0);
+
+  short *ptr = static_cast<short *>(image->GetScalarPointer());
+  for (int k = 0; k < dims[2]; k++)
+  {
+    for (int j = 0; j < dims[1]; j++)
+    {
+      for (int i = 0; i < dims[0]; i++)
+      {
+        double p[4] = {
+          origin[0] + i*spacing[0],
+          origin[1] + j*spacing[1],
+          origin[2] + k*spacing[2],
+          1.0 };
+        matrix->MultiplyPoint(p, p);
+        seed = seed*1664525u + 1013904223u;
+        double r = (seed >> 8)/16777216.0 - 0.5;
+        double v = Phantom(p, ct) + noise*r;
+        *ptr++ = static_cast<short>(vtkMath::Round(v));
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void MakeSyntheticPair(ImagePair *pair)
+{
+  static const int mrDims[3] = { 136, 136, 120 };
+  static const double mrSpacing[3] = { 1.5, 1.5, 1.5 };
+  static const int ctDims[3] = { 200, 200, 80 };
+  static const double ctSpacing[3] = { 1.0, 1.0, 2.5 };
+
+  pair->Name = "synthetic";
+  pair->Target = vtkSmartPointer<vtkImageData>::New();
+  pair->TargetMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  pair->Source = vtkSmartPointer<vtkImageData>::New();
+  pair->SourceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+  MakePhantomImage(pair->Target, mrDims, mrSpacing,
+                   pair->TargetMatrix, false);
+  MakePhantomImage(pair->Source, ctDims, ctSpacing,
+                   pair->SourceMatrix, true);
+}
+
+//----------------------------------------------------------------------------
+// Read a NIFTI file into DICOM patient coordinates (like Tactics does)
+bool ReadNIFTIImage(const std::string& fileName, vtkImageData *data,
+                    vtkMatrix4x4 *matrix)
+{
+  vtkSmartPointer<vtkNIFTIReader> reader =
+    vtkSmartPointer<vtkNIFTIReader>::New();
+  if (!reader->CanReadFile(fileName.c_str()))
+  {
+    return false;
+  }
+  reader->SetFileName(fileName.c_str());
+  reader->Update();
+
+  vtkSmartPointer<vtkDICOMToRAS> reorder =
+    vtkSmartPointer<vtkDICOMToRAS>::New();
+  reorder->RASToDICOMOn();
+  reorder->RASMatrixHasPositionOn();
+  reorder->SetInputConnection(reader->GetOutputPort());
+  if (reader->GetQFormMatrix())
+  {
+    reorder->SetRASMatrix(reader->GetQFormMatrix());
+  }
+  else if (reader->GetSFormMatrix())
+  {
+    reorder->SetRASMatrix(reader->GetSFormMatrix());
+  }
+  reorder->Update();
+
+  data->ShallowCopy(reorder->GetOutput());
+  matrix->DeepCopy(reorder->GetPatientMatrix());
+
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void ReadPairs(const std::string& dirName, std::vector<ImagePair> *pairs)
+{
+  static const std::string suffix = "_primary.nii.gz";
+
+  vtkSmartPointer<vtkDirectory> dir = vtkSmartPointer<vtkDirectory>::New();
+  if (!dir->Open(dirName.c_str()))
+  {
+    std::cerr << "Cannot open directory " << dirName << std::endl;
+    return;
+  }
+
+  for (vtkIdType i = 0; i < dir->GetNumberOfFiles(); i++)
+  {
+    std::string fileName = dir->GetFile(i);
+    size_t l = fileName.length();
+    if (l <= suffix.length() ||
+        fileName.compare(l - suffix.length(), suffix.length(), suffix) != 0)
+    {
+      continue;
+    }
+
+    ImagePair pair;
+    pair.Name = fileName.substr(0, l - suffix.length());
+    pair.Target = vtkSmartPointer<vtkImageData>::New();
+    pair.TargetMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    pair.Source = vtkSmartPointer<vtkImageData>::New();
+    pair.SourceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+    std::string base = dirName + "/" + pair.Name;
+    if (ReadNIFTIImage(base + "_primary.nii.gz",
+                       pair.Target, pair.TargetMatrix) &&
+        ReadNIFTIImage(base + "_secondary.nii.gz",
+                       pair.Source, pair.SourceMatrix))
+    {
+      pairs->push_back(pair);
+    }
+    else
+    {
+      std::cerr << "Skipping incomplete pair " << pair.Name << std::endl;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+// The RMS distance between two source matrices, measured at the corners
+// of a head-sized box around the center of the target image
+double ResidualError(vtkImageData *target, vtkMatrix4x4 *targetMatrix,
+                     vtkMatrix4x4 *result, vtkMatrix4x4 *truth)
+{
+  static const double halfSize[3] = { 60.0, 75.0, 60.0 };
+
+  double bounds[6];
+  target->GetBounds(bounds);
+  double center[4] = { 0.0, 0.0, 0.0, 1.0 };
+  for (int j = 0; j < 3; j++)
+  {
+    center[j] = 0.5*(bounds[2*j] + bounds[2*j+1]);
+  }
+  targetMatrix->MultiplyPoint(center, center);
+
+  // convert from patient coords to source data coords with each matrix
+  vtkSmartPointer<vtkMatrix4x4> resultInverse =
+    vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(result, resultInverse);
+  vtkSmartPointer<vtkMatrix4x4> truthInverse =
+    vtkSmartPointer<vtkMatrix4x4>::New();
+  vtkMatrix4x4::Invert(truth, truthInverse);
+
+  double sum = 0.0;
+  for (int i = 0; i < 8; i++)
+  {
+    double p[4], q[4];
+    for (int j = 0; j < 3; j++)
+    {
+      p[j] = center[j] + (((i >> j) & 1) ? halfSize[j] : -halfSize[j]);
+    }
+    p[3] = 1.0;
+    resultInverse->MultiplyPoint(p, q);
+    truthInverse->MultiplyPoint(p, p);
+    sum += vtkMath::Distance2BetweenPoints(p, q);
+  }
+
+  return std::sqrt(sum/8.0);
+}
+
+//----------------------------------------------------------------------------
+// Run one registration, and write the results as one line of JSON
+void RunBenchmark(const ImagePair& pair, int offsetIndex, int method,
+                  const Schedule& schedule, int starts, std::ostream& os)
+{
+  // misalign the source by the known offset
+  vtkMatrix4x4 *targetMatrix = vtkMatrix4x4::New();
+  targetMatrix->DeepCopy(pair.TargetMatrix);
+  vtkMatrix4x4 *sourceMatrix = vtkMatrix4x4::New();
+  vtkSmartPointer<vtkMatrix4x4> offset =
+    vtkSmartPointer<vtkMatrix4x4>::New();
+  OffsetToMatrix(Offsets[offsetIndex], offset);
+  offset->Invert();
+  vtkMatrix4x4::Multiply4x4(offset, pair.SourceMatrix, sourceMatrix);
+
+  cbMRIRegistration *registration = cbMRIRegistration::New();
+  registration->SetInputTarget(pair.Target);
+  registration->SetInputTargetMatrix(targetMatrix);
+  registration->SetInputSource(pair.Source);
+  registration->SetInputSourceMatrix(sourceMatrix);
+  registration->SetRegistrationMethod(method);
+  registration->SetNumberOfStarts(starts);
+
+  double startTime = vtkTimerLog::GetUniversalTime();
+
+  registration->Initialize();
+  for (int level = 0; level < schedule.NumberOfLevels; level++)
+  {
+    registration->StartLevel(schedule.BlurFactors[level]);
+    while (registration->Iterate()) {}
+  }
+  registration->Finish();
+
+  double wallTime = vtkTimerLog::GetUniversalTime() - startTime;
+
+  double error = ResidualError(pair.Target, targetMatrix,
+                               sourceMatrix, pair.SourceMatrix);
+
+  os << "{\"pair\": \"" << pair.Name << "\""
+     << ", \"offset\": " << offsetIndex
+     << ", \"metric\": \"" << (method == 0 ? "MI" : "CC") << "\""
+     << ", \"schedule\": \"" << schedule.Name << "\""
+     << ", \"starts\": " << starts
+     << ", \"wall_time\": " << wallTime
+     << ", \"levels\": [";
+  for (int i = 0; i < registration->GetNumberOfLevels(); i++)
+  {
+    const cbMRIRegistration::LevelStatistics& stats =
+      registration->GetLevelStatistics(i);
+    os << (i == 0 ? "" : ", ")
+       << "{\"blur\": " << stats.BlurFactor
+       << ", \"wall_time\": " << stats.WallTime
+       << ", \"resize_time\": " << stats.ResizeTime
+       << ", \"metric_time\": " << stats.MetricTime
+       << ", \"multi_start_time\": " << stats.MultiStartTime
+       << ", \"evaluations\": " << stats.NumberOfEvaluations
+       << ", \"multi_start_evaluations\": " << stats.MultiStartEvaluations
+       << ", \"final_metric\": "
+       << (stats.MetricValues.empty() ? 0.0 : stats.MetricValues.back())
+       << ", \"translation_delta\": " << stats.TranslationDelta
+       << ", \"rotation_delta\": " << stats.RotationDelta << "}";
+  }
+  os << "], \"residual_error\": " << error << "}" << std::endl;
+
+  delete registration;
+  targetMatrix->Delete();
+  sourceMatrix->Delete();
+}
+
+} // end anonymous namespace
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  std::string pairsDir;
+  std::string outputFile;
+  int starts = 1;
+
+  for (int argi = 1; argi < argc; argi++)
+  {
+    std::string arg = argv[argi];
+    if (arg == "--pairs" && argi + 1 < argc)
+    {
+      pairsDir = argv[++argi];
+    }
+    else if (arg == "--output" && argi + 1 < argc)
+    {
+      outputFile = argv[++argi];
+    }
+    else if (arg == "--starts" && argi + 1 < argc)
+    {
+      starts = atoi(argv[++argi]);
+    }
+    else
+    {
+      std::cerr << "Usage: " << argv[0]
+                << " [--pairs dir] [--output file] [--starts n]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<ImagePair> pairs;
+  if (pairsDir.empty())
+  {
+    ImagePair pair;
+    MakeSyntheticPair(&pair);
+    pairs.push_back(pair);
+  }
+  else
+  {
+    ReadPairs(pairsDir, &pairs);
+  }
+
+  if (pairs.empty())
+  {
+    std::cerr << "No image pairs to register." << std::endl;
+    return 1;
+  }
+
+  std::ofstream ofile;
+  if (!outputFile.empty())
+  {
+    ofile.open(outputFile.c_str());
+    if (!ofile.good())
+    {
+      std::cerr << "Cannot write to " << outputFile << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& os = (outputFile.empty() ? std::cout : ofile);
+
+  const int numberOfOffsets = sizeof(Offsets)/sizeof(Offset);
+  const int numberOfSchedules = sizeof(Schedules)/sizeof(Schedule);
+
+  for (size_t i = 0; i < pairs.size(); i++)
+  {
+    for (int j = 0; j < numberOfOffsets; j++)
+    {
+      // 0 is mutual information, 1 is cross correlation
+      for (int method = 0; method < 2; method++)
+      {
+        for (int k = 0; k < numberOfSchedules; k++)
+        {
+          RunBenchmark(pairs[i], j, method, Schedules[k], starts, os);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
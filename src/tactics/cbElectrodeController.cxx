@@ -41,18 +41,20 @@
 
 #include "vtkTransform.h"
 #include "cbMRIRegistration.h"
+#include "cbFrameFinder.h"
 #include "vtkImageResize.h"
 #include "vtkImageReslice.h"
 
 #include "vtkLinearTransform.h"
-#include "vtkFrameFinder.h"
+#include "vtkProgressAccumulator.h"
 #include "vtkCellArray.h"
 #include "vtkCellData.h"
-#include "vtkImageStencil.h"
+#include "vtkImageStencilData.h"
 #include "vtkImageMRIBrainExtractor.h"
 #include "vtkPolyDataToImageStencil.h"
 #include "vtkPolyData.h"
 #include "vtkTimerLog.h"
+#include "vtkCommand.h"
 
 #include "vtkMatrix4x4.h"
 #include "vtkImageNode.h"
@@ -72,6 +74,7 @@
 #include "vtkMNITagPointReader2.h"
 #include "vtkTransformPolyDataFilter.h"
 
+#include <QCryptographicHash>
 #include <QDate>
 #include <QTime>
 #include <QDateTime>
@@ -79,8 +82,16 @@
 #include <QFileInfo>
 #include <QString>
 #include <QMessageBox>
+#include <QSettings>
+#include <QVariant>
+#include <QThread>
+#include <QThreadPool>
+#include <QEventLoop>
+#include <QTimer>
 #include <QDebug>
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include <sstream>
 #include <iostream>
@@ -100,9 +111,12 @@ void ReadDICOMImage(vtkStringArray *sarray, vtkImageData *data,
 void ReadNIFTIImage(const std::string& fileName, vtkImageData *data,
                     vtkMatrix4x4 *matrix);
 
+void ResliceToPrimary(vtkImageData *data, vtkMatrix4x4 *matrix,
+                      vtkImageData *primary, vtkMatrix4x4 *primaryMatrix);
+
 cbElectrodeController::cbElectrodeController(vtkDataManager *dataManager)
-: cbApplicationController(dataManager), dataKey(), volumeKey(), ctKey(),
-  Plan(0), FrameMatrix(0)
+: cbApplicationController(dataManager), dataKey(), volumeKey(),
+  brainKey(), secondaryKeys(), Plan(0), FrameMatrix(0)
 {
   vtkSmartPointer<vtkImageNode> dataNode =
     vtkSmartPointer<vtkImageNode>::New();
@@ -110,12 +124,40 @@ cbElectrodeController::cbElectrodeController(vtkDataManager *dataManager)
   vtkSmartPointer<vtkImageNode> volumeNode =
     vtkSmartPointer<vtkImageNode>::New();
   this->dataManager->AddDataNode(volumeNode, this->volumeKey);
+  vtkSmartPointer<vtkSurfaceNode> brainNode =
+    vtkSmartPointer<vtkSurfaceNode>::New();
+  this->dataManager->AddDataNode(brainNode, this->brainKey);
 
   this->useAnteriorPosteriorFiducials = false;
+  this->recomputeFrame = false;
+
+  // brain extraction is done at this voxel size, or 0.0 for full size
+  QSettings settings;
+  this->brainExtractionSpacing =
+    settings.value("brainExtractionSpacing", 1.5).toDouble();
+
+  // extract the brain in the background, or wait until it is needed
+  this->extractSurfaceOnDemand =
+    settings.value("extractSurfaceOnDemand", false).toBool();
+
+  // if the secondary series is often acquired with the head in a very
+  // different position, several starting orientations can be tried
+  this->registrationStarts =
+    settings.value("registrationStarts", 1).toInt();
+  this->CancellableRunning = false;
+  this->SurfaceCancellation = std::make_shared<cbCancellationToken>();
+  this->SurfacePool = new QThreadPool(this);
+  this->SurfacePool->setMaxThreadCount(1);
+  this->ProgressRange[0] = 0;
+  this->ProgressRange[1] = 100;
 }
 
 cbElectrodeController::~cbElectrodeController()
 {
+  // the background brain extraction must not outlive the controller
+  this->SurfaceCancellation->Cancel();
+  this->SurfacePool->waitForDone();
+
   if (this->FrameMatrix) {
     this->FrameMatrix->Delete();
   }
@@ -207,6 +249,30 @@ void WriteNIFTIImage(const std::string& fileName, vtkImageData *data,
   writer->Write();
 }
 
+// Resample an image onto the grid of the primary image
+void ResliceToPrimary(vtkImageData *data, vtkMatrix4x4 *matrix,
+                      vtkImageData *primary, vtkMatrix4x4 *primaryMatrix)
+{
+  vtkNew<vtkImageReslice> reslicer;
+  reslicer->SetInterpolationModeToCubic();
+  reslicer->SetInputData(data);
+  reslicer->SetInformationInput(primary);
+
+  vtkNew<vtkMatrix4x4> invertedMatrix;
+  invertedMatrix->DeepCopy(matrix);
+  invertedMatrix->Invert();
+
+  vtkNew<vtkTransform> resliceTransform;
+  resliceTransform->PostMultiply();
+  resliceTransform->Concatenate(primaryMatrix);
+  resliceTransform->Concatenate(invertedMatrix);
+
+  reslicer->SetResliceTransform(resliceTransform);
+  reslicer->Update();
+
+  data->DeepCopy(reslicer->GetOutput());
+}
+
 void cbElectrodeController::log(QString m)
 {
   // Get the current system datetime
@@ -217,10 +283,99 @@ void cbElectrodeController::log(QString m)
   emit Log(dateTimeString.append(m));
 }
 
+void cbElectrodeController::cancel()
+{
+  // the background extraction is only stopped by the cancel button
+  // when it is the only thing that the button is shown for
+  if (this->CancellableRunning) {
+    this->Cancellation.Cancel();
+  }
+  else {
+    this->SurfaceCancellation->Cancel();
+  }
+}
+
+void cbElectrodeController::beginCancellable()
+{
+  this->Cancellation.Reset();
+  this->CancellableRunning = true;
+  emit enableCancel(true);
+}
+
+void cbElectrodeController::endCancellable()
+{
+  this->CancellableRunning = false;
+  emit enableCancel(false);
+}
+
+void cbElectrodeController::cancelled()
+{
+  this->log(QString("Operation cancelled."));
+  this->CancellableRunning = false;
+  emit enableCancel(false);
+  emit initializeProgress(0, 100);
+  emit displayProgress(0);
+  emit displayStatus("Cancelled.", 5000);
+}
+
+void cbElectrodeController::watchFilter(
+  vtkAlgorithm *filter, int start, int end)
+{
+  this->ProgressRange[0] = start;
+  this->ProgressRange[1] = end;
+  this->Cancellation.Watch(filter);
+  filter->AddObserver(vtkCommand::ProgressEvent,
+                      this, &cbElectrodeController::filterProgress);
+}
+
+void cbElectrodeController::filterProgress(
+  vtkObject *caller, unsigned long, void *)
+{
+  // only the GUI thread can safely pump the event loop
+  if (QThread::currentThread() != this->thread()) {
+    return;
+  }
+
+  // the caller is either a filter or a progress accumulator
+  double progress = 0.0;
+  vtkProgressAccumulator *accumulator =
+    vtkProgressAccumulator::SafeDownCast(caller);
+  if (accumulator) {
+    progress = accumulator->GetAccumulatedProgress();
+  }
+  else {
+    progress = static_cast<vtkAlgorithm *>(caller)->GetProgress();
+  }
+
+  int start = this->ProgressRange[0];
+  int end = this->ProgressRange[1];
+  emit displayProgress(start + static_cast<int>((end - start)*progress));
+}
+
+void cbElectrodeController::surfaceStep(int step, int numberOfSteps)
+{
+  if (!this->CancellableRunning) {
+    emit displayStatus("Extracting brain surface (step " +
+                       QString::number(step) + " of " +
+                       QString::number(numberOfSteps) + ")...");
+  }
+}
+
+void cbElectrodeController::surfaceProgress(
+  vtkObject *caller, unsigned long, void *)
+{
+  // the signal is queued, since it is emitted from the worker thread
+  if (!this->CancellableRunning) {
+    double progress = static_cast<vtkAlgorithm *>(caller)->GetProgress();
+    emit displayProgress(static_cast<int>(100*progress));
+  }
+}
+
 void cbElectrodeController::requestOpenImage(const QStringList& files)
 {
   //assert(path && "Path can't be NULL!");
 
+  this->beginCancellable();
   emit initializeProgress(0, 100);
   emit displayStatus("Loading primary image...");
 
@@ -246,23 +401,31 @@ void cbElectrodeController::requestOpenImage(const QStringList& files)
   // is changed within the registration filter. This means that the function
   // MUST be called before displayData(dataKey), so that the matrix used
   // for the actors is correct
-  this->buildAndDisplayFrame(data, matrix);
-
-  emit displayProgress(50);
-  emit displayStatus("Extracting brain from image...");
-  this->extractAndDisplaySurface(data, matrix);
+  if (!this->buildAndDisplayFrame(data, matrix, files, meta)) {
+    this->cancelled();
+    return;
+  }
 
   emit displayProgress(75);
-  emit displayStatus("Rendering brain volume...");
+  emit displayStatus("Displaying primary image...");
 
   this->dataManager->FindImageNode(dataKey)->ShallowCopyImage(data);
   this->dataManager->FindImageNode(dataKey)->SetMatrix(matrix);
   this->dataManager->FindImageNode(dataKey)->SetMetaData(meta);
 
+  // any secondary series were registered to the previous primary
+  this->secondaryKeys.clear();
+  this->secondaryStats.clear();
+
   emit displayData(dataKey);
-  emit displaySurfaceVolume(volumeKey);
+
+  // the brain surface is only needed for the surface pane, so the
+  // image can be planned on while the brain is extracted
+  this->scheduleSurfaceExtraction(data, matrix);
+
   emit displayProgress(100);
   emit displayStatus("Finished loading primary image.", 5000);
+  this->endCancellable();
   emit finished();
 }
 
@@ -272,6 +435,7 @@ void cbElectrodeController::OpenImageWithMatrix(
 {
   //assert(path && "Path can't be NULL!");
 
+  // this is part of OpenPlan(), which makes it cancellable
   emit initializeProgress(0, 100);
   emit displayStatus("Loading primary image...");
 
@@ -289,26 +453,29 @@ void cbElectrodeController::OpenImageWithMatrix(
 
   ReadImage(sarray, data, matrix, meta);
 
-  emit displayProgress(50);
-  emit displayStatus("Extracting brain from image...");
-  this->extractAndDisplaySurface(data, m);
-
   emit displayProgress(75);
-  emit displayStatus("Rendering brain volume...");
+  emit displayStatus("Displaying primary image...");
 
   this->dataManager->FindImageNode(dataKey)->ShallowCopyImage(data);
   this->dataManager->FindImageNode(dataKey)->SetMatrix(m);
   this->dataManager->FindImageNode(dataKey)->SetMetaData(meta);
 
+  // any secondary series were registered to the previous primary
+  this->secondaryKeys.clear();
+  this->secondaryStats.clear();
+
   emit displayData(dataKey);
-  emit displaySurfaceVolume(volumeKey);
+
+  this->scheduleSurfaceExtraction(data, m);
+
   emit displayProgress(100);
   emit displayStatus("Finished loading primary image.", 5000);
   emit finished();
 }
 
-void cbElectrodeController::extractAndDisplaySurface(vtkImageData *data,
-                                                     vtkMatrix4x4 *matrix)
+vtkSmartPointer<vtkImageStencilData>
+cbElectrodeController::extractBrainStencil(
+  vtkImageData *data, cbCancellationToken *token, vtkPolyData *brainMesh)
 {
   int extent[6];
   double spacing[3];
@@ -317,8 +484,40 @@ void cbElectrodeController::extractAndDisplaySurface(vtkImageData *data,
   data->GetSpacing(spacing);
   data->GetOrigin(origin);
 
+  // the brain mesh is only used to mask the surface volume, so fine
+  // voxels can be downsampled before extraction; the resized image has
+  // the same data coordinates, so the mesh fits the full-resolution data
+  vtkSmartPointer<vtkImageData> extractorInput = data;
+  double targetSpacing = this->brainExtractionSpacing;
+  if (targetSpacing > 0.0 &&
+      (spacing[0] < targetSpacing || spacing[1] < targetSpacing ||
+       spacing[2] < targetSpacing)) {
+    double reducedSpacing[3];
+    for (int i = 0; i < 3; i++) {
+      reducedSpacing[i] = (spacing[i] > targetSpacing ?
+                           spacing[i] : targetSpacing);
+    }
+    this->surfaceStep(1, 3);
+    vtkNew<vtkImageResize> reduce;
+    reduce->SetInputData(data);
+    reduce->SetResizeMethodToOutputSpacing();
+    reduce->SetOutputSpacing(reducedSpacing);
+    token->Watch(reduce);
+    reduce->AddObserver(vtkCommand::ProgressEvent,
+                        this, &cbElectrodeController::surfaceProgress);
+    reduce->Update();
+
+    if (token->IsCancelled()) {
+      return nullptr;
+    }
+
+    extractorInput = reduce->GetOutput();
+    extractorInput->GetExtent(extent);
+    extractorInput->GetSpacing(spacing);
+  }
+
   vtkNew<vtkImageMRIBrainExtractor> extractor;
-  extractor->SetInputData(data);
+  extractor->SetInputData(extractorInput);
 
   double bt = 0.0;
   if (spacing[2] > 1.5)
@@ -337,70 +536,336 @@ void cbElectrodeController::extractAndDisplaySurface(vtkImageData *data,
   extractor->SetBT(bt);
   extractor->SetBrainExtent(extent[0], extent[1], extent[2],
                             extent[3], extent[4], extent[5]);
+  this->surfaceStep(2, 3);
+  token->Watch(extractor);
+  extractor->AddObserver(vtkCommand::ProgressEvent,
+                         this, &cbElectrodeController::surfaceProgress);
   extractor->Update();
 
+  if (token->IsCancelled()) {
+    return nullptr;
+  }
+
   vtkSmartPointer<vtkPolyData> mesh = extractor->GetBrainMesh();
+  if (brainMesh) {
+    brainMesh->DeepCopy(mesh);
+  }
 
-  double bounds[6], length[3];
-  int maxi = 0;
+  // the stencil covers the mesh bounds, plus a margin
+  double bounds[6];
+  int stencilExtent[6];
   mesh->GetBounds(bounds);
+  data->GetExtent(extent);
+  data->GetSpacing(spacing);
   for (int i = 0; i < 3; i++) {
-    bounds[2*i] -= 1.0;
-    bounds[2*i + 1] += 1.0;
-    length[i] = bounds[2*i + 1] - bounds[2*i];
-    if (length[i] > length[maxi]) {
-      maxi = i;
+    double lo = (bounds[2*i] - 1.0 - origin[i])/spacing[i];
+    double hi = (bounds[2*i + 1] + 1.0 - origin[i])/spacing[i];
+    stencilExtent[2*i] = vtkMath::Floor(lo < hi ? lo : hi);
+    stencilExtent[2*i + 1] = vtkMath::Ceil(lo < hi ? hi : lo);
+    if (stencilExtent[2*i] < extent[2*i]) {
+      stencilExtent[2*i] = extent[2*i];
+    }
+    if (stencilExtent[2*i + 1] > extent[2*i + 1]) {
+      stencilExtent[2*i + 1] = extent[2*i + 1];
     }
   }
 
-  int dimensions[3];
-  dimensions[maxi] = static_cast<int>(length[maxi]);
-  for (int j = 1; j < 3; j++) {
-    int k = (maxi+j)%3;
-    double aspect = length[k]/length[maxi];
-    dimensions[k] = static_cast<int>(aspect*dimensions[maxi]);
-  }
-
-  vtkNew<vtkImageResize> resize;
-  resize->SetInputData(data);
-  resize->SetOutputDimensions(dimensions);
-  resize->CroppingOn();
-  resize->SetCroppingRegion(bounds);
-  resize->Update();
-
+  // the surface volume is the primary image, masked by the brain
+  // stencil when it is rendered, so no masked copy is needed
   vtkNew<vtkPolyDataToImageStencil> makeStencil;
   makeStencil->SetInputData(mesh);
-  makeStencil->SetInformationInput(resize->GetOutput());
+  makeStencil->SetOutputOrigin(origin);
+  makeStencil->SetOutputSpacing(spacing);
+  makeStencil->SetOutputWholeExtent(stencilExtent);
+  this->surfaceStep(3, 3);
+  token->Watch(makeStencil);
+  makeStencil->AddObserver(vtkCommand::ProgressEvent,
+                           this, &cbElectrodeController::surfaceProgress);
   makeStencil->Update();
 
-  vtkNew<vtkImageStencil> brainStencil;
-  brainStencil->SetInputData(resize->GetOutput());
-  brainStencil->SetStencilConnection(makeStencil->GetOutputPort());
-  brainStencil->Update();
+  if (token->IsCancelled()) {
+    return nullptr;
+  }
+
+  vtkSmartPointer<vtkImageStencilData> brainStencil =
+    vtkSmartPointer<vtkImageStencilData>::New();
+  brainStencil->DeepCopy(makeStencil->GetOutput());
 
-  vtkImageData *brainSurface = brainStencil->GetOutput();
+  return brainStencil;
+}
 
-  this->dataManager->FindImageNode(volumeKey)->ShallowCopyImage(brainSurface);
+void cbElectrodeController::displaySurface(
+  vtkImageData *data, vtkMatrix4x4 *matrix, vtkImageStencilData *stencil,
+  vtkPolyData *brainMesh)
+{
+  this->dataManager->FindImageNode(volumeKey)->ShallowCopyImage(data);
+  this->dataManager->FindImageNode(volumeKey)->SetStencil(stencil);
   this->dataManager->FindImageNode(volumeKey)->SetMatrix(matrix);
+
+  this->dataManager->FindSurfaceNode(brainKey)->ShallowCopySurface(brainMesh);
+  this->dataManager->FindSurfaceNode(brainKey)->SetMatrix(matrix);
+
+  emit displayBrainSurface(brainKey);
+  emit displaySurfaceVolume(volumeKey);
+}
+
+void cbElectrodeController::scheduleSurfaceExtraction(
+  vtkImageData *data, vtkMatrix4x4 *matrix)
+{
+  // abandon the extraction for any previously loaded image
+  this->SurfaceCancellation->Cancel();
+  this->SurfaceCancellation = std::make_shared<cbCancellationToken>();
+
+  // use copies, so that the caller can reuse the image and matrix
+  this->PendingSurfaceData = vtkSmartPointer<vtkImageData>::New();
+  this->PendingSurfaceData->ShallowCopy(data);
+  this->PendingSurfaceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  this->PendingSurfaceMatrix->DeepCopy(matrix);
+
+  if (!this->extractSurfaceOnDemand) {
+    QTimer::singleShot(0, this, SLOT(requestSurfaceVolume()));
+  }
+}
+
+void cbElectrodeController::requestSurfaceVolume()
+{
+  if (!this->PendingSurfaceData) {
+    return;
+  }
+
+  vtkSmartPointer<vtkImageData> data = this->PendingSurfaceData;
+  vtkSmartPointer<vtkMatrix4x4> matrix = this->PendingSurfaceMatrix;
+  std::shared_ptr<cbCancellationToken> token = this->SurfaceCancellation;
+  this->PendingSurfaceData = nullptr;
+  this->PendingSurfaceMatrix = nullptr;
+
+  this->log(QString("Extracting brain surface in the background."));
+
+  // the cancel button stops the extraction, unless it is in use
+  if (!this->CancellableRunning) {
+    emit initializeProgress(0, 100);
+    emit enableCancel(true);
+  }
+
+  this->SurfacePool->start([this, data, matrix, token]() {
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    vtkSmartPointer<vtkImageStencilData> stencil =
+      this->extractBrainStencil(data, token.get(), mesh);
+
+    // the data manager and the view must only be used on the GUI thread
+    QMetaObject::invokeMethod(this, [this, data, matrix, token, stencil,
+                                     mesh]() {
+      if (!this->CancellableRunning) {
+        emit enableCancel(false);
+      }
+      if (stencil && !token->IsCancelled()) {
+        this->displaySurface(data, matrix, stencil, mesh);
+        emit displayProgress(100);
+        emit displayStatus("Brain surface is ready.", 5000);
+      }
+      else if (token == this->SurfaceCancellation) {
+        // keep the image, so that the extraction can be requested again
+        this->log(QString("Brain surface extraction cancelled."));
+        this->SurfaceCancellation = std::make_shared<cbCancellationToken>();
+        this->PendingSurfaceData = data;
+        this->PendingSurfaceMatrix = matrix;
+        emit displayStatus("Brain surface extraction cancelled.", 5000);
+      }
+    }, Qt::QueuedConnection);
+  });
+}
+
+namespace { // helper functions for the frame cache
+
+//! The settings group that holds the cached frame-finding results.
+const char *FrameCacheGroup = "frameCache";
+
+//! The cache key, from the series UID or (for NIfTI) the file path.
+QString FrameCacheKey(const QStringList& files, vtkDICOMMetaData *meta,
+                      bool useAP)
+{
+  QString key;
+  if (meta && meta->Has(DC::SeriesInstanceUID)) {
+    key = QString::fromStdString(
+      meta->Get(DC::SeriesInstanceUID).AsString());
+  }
+  if (key.isEmpty() && !files.isEmpty()) {
+    key = QFileInfo(files[0]).absoluteFilePath();
+  }
+  if (key.isEmpty()) {
+    return key;
+  }
+
+  // settings keys cannot contain slashes, so use a hash of the key
+  QByteArray hash = QCryptographicHash::hash(
+    key.toUtf8(), QCryptographicHash::Sha1).toHex();
+  return QString::fromLatin1(hash) + (useAP ? "-ap" : "-lr");
+}
+
+//! A fingerprint of the files, to detect changes to a series.
+QString FileFingerprint(const QStringList& files)
+{
+  qint64 totalSize = 0;
+  qint64 lastModified = 0;
+  for (int i = 0; i < files.size(); i++) {
+    QFileInfo info(files[i]);
+    totalSize += info.size();
+    qint64 t = info.lastModified().toMSecsSinceEpoch();
+    lastModified = (t > lastModified ? t : lastModified);
+  }
+  return QString("%1:%2:%3").arg(files.size()).arg(totalSize)
+                            .arg(lastModified);
 }
 
-void cbElectrodeController::buildAndDisplayFrame(vtkImageData *data,
-                                                 vtkMatrix4x4 *matrix)
+};
+
+bool cbElectrodeController::loadFrameCache(
+  const QStringList& files, vtkDICOMMetaData *meta,
+  vtkMatrix4x4 *frameMatrix, bool *success,
+  std::vector<double> *fiducialRMS)
 {
-  vtkNew<vtkFrameFinder> regist;
-  regist->SetInputData(data);
-  regist->SetDICOMPatientMatrix(matrix);
-  regist->SetUsePosteriorFiducial(this->useAnteriorPosteriorFiducials);
-  regist->SetUseAnteriorFiducial(this->useAnteriorPosteriorFiducials);
-  regist->Update();
+  QString key = FrameCacheKey(files, meta,
+                              this->useAnteriorPosteriorFiducials);
+  if (key.isEmpty()) {
+    return false;
+  }
+
+  QSettings settings;
+  settings.beginGroup(FrameCacheGroup);
+  QVariantMap entry = settings.value(key).toMap();
+  settings.endGroup();
+
+  if (entry.value("fingerprint").toString() != FileFingerprint(files)) {
+    return false;
+  }
+
+  // entries that were saved without the residuals are not used
+  QVariantList elements = entry.value("matrix").toList();
+  if (elements.size() != 16 || !entry.contains("fiducialRMS")) {
+    return false;
+  }
+  for (int i = 0; i < 16; i++) {
+    frameMatrix->SetElement(i/4, i%4, elements[i].toDouble());
+  }
+  *success = entry.value("success").toBool();
+
+  QVariantList residuals = entry.value("fiducialRMS").toList();
+  fiducialRMS->clear();
+  for (int i = 0; i < residuals.size(); i++) {
+    fiducialRMS->push_back(residuals[i].toDouble());
+  }
+
+  return true;
+}
+
+void cbElectrodeController::saveFrameCache(
+  const QStringList& files, vtkDICOMMetaData *meta,
+  vtkMatrix4x4 *frameMatrix, bool success,
+  const std::vector<double>& fiducialRMS)
+{
+  QString key = FrameCacheKey(files, meta,
+                              this->useAnteriorPosteriorFiducials);
+  if (key.isEmpty()) {
+    return;
+  }
+
+  QVariantList elements;
+  for (int i = 0; i < 16; i++) {
+    elements.append(frameMatrix->GetElement(i/4, i%4));
+  }
+
+  QVariantList residuals;
+  for (size_t i = 0; i < fiducialRMS.size(); i++) {
+    residuals.append(fiducialRMS[i]);
+  }
+
+  QVariantMap entry;
+  entry["fingerprint"] = FileFingerprint(files);
+  entry["matrix"] = elements;
+  entry["success"] = success;
+  entry["fiducialRMS"] = residuals;
+
+  QSettings settings;
+  settings.beginGroup(FrameCacheGroup);
+  settings.setValue(key, entry);
+  settings.endGroup();
+}
+
+bool cbElectrodeController::buildAndDisplayFrame(
+  vtkImageData *data, vtkMatrix4x4 *matrix,
+  const QStringList& files, vtkDICOMMetaData *meta)
+{
+  vtkNew<vtkMatrix4x4> imageToFrame;
+  bool success = false;
+  std::vector<double> fiducialRMS;
+
+  // frame finding is slow, so reuse the result for a known series
+  bool cached = (!this->recomputeFrame &&
+                 this->loadFrameCache(files, meta, imageToFrame,
+                                      &success, &fiducialRMS));
+
+  if (cached) {
+    this->log(QString("Using saved frame for this series."));
+  }
+  else {
+    // find the frame in a downsampled image, then refine it at full
+    // resolution near the predicted fiducial planes
+    vtkNew<vtkProgressAccumulator> accumulator;
+    this->ProgressRange[0] = 25;
+    this->ProgressRange[1] = 50;
+    accumulator->AddObserver(vtkCommand::ProgressEvent,
+                             this, &cbElectrodeController::filterProgress);
+
+    cbFrameFinder *regist = cbFrameFinder::New();
+    regist->SetInput(data);
+    regist->SetDICOMPatientMatrix(matrix);
+    regist->SetUseAnteriorPosteriorFiducials(
+      this->useAnteriorPosteriorFiducials);
+    regist->SetCancellationToken(&this->Cancellation);
+    regist->SetProgressAccumulator(accumulator);
+    regist->Execute();
+
+    if (regist->GetUsedCoarseToFine()) {
+      this->log(QString("Frame found with coarse-to-fine search."));
+    }
+
+    success = regist->GetSuccess();
+    for (int i = 0; i < regist->GetNumberOfFiducials(); i++) {
+      fiducialRMS.push_back(regist->GetFiducialRMS(i));
+    }
+    imageToFrame->DeepCopy(regist->GetImageToFrameMatrix());
+
+    delete regist;
+
+    if (this->Cancellation.IsCancelled()) {
+      return false;
+    }
+
+    this->saveFrameCache(files, meta, imageToFrame, success, fiducialRMS);
+  }
+
+  // the average is shown, the residual of each fiducial is logged
+  static const char *fiducialNames[4] = {
+    "left", "right", "anterior", "posterior" };
+  double rms = 0.0;
+  QString residuals = "Fiducial RMS:";
+  for (size_t i = 0; i < fiducialRMS.size() && i < 4; i++) {
+    rms += fiducialRMS[i];
+    residuals += QString(" %1 %2mm").arg(fiducialNames[i])
+                                    .arg(fiducialRMS[i]);
+  }
+  if (!fiducialRMS.empty()) {
+    rms /= fiducialRMS.size();
+    this->log(residuals);
+  }
 
   if (this->FrameMatrix) {
     this->FrameMatrix->Delete();
   }
   this->FrameMatrix = vtkMatrix4x4::New();
 
-  if (regist->GetSuccess()) {
-    this->FrameMatrix->DeepCopy(regist->GetImageToFrameMatrix());
+  if (success) {
+    this->FrameMatrix->DeepCopy(imageToFrame);
   }
   else {
     vtkNew<vtkMatrix4x4> flipMatrix;
@@ -412,13 +877,15 @@ void cbElectrodeController::buildAndDisplayFrame(vtkImageData *data,
     vtkMatrix4x4::Multiply4x4(flipMatrix, matrix, this->FrameMatrix);
   }
   emit displayLeksellFrame(this->FrameMatrix);
-  emit displayFrameRMS(regist->GetAverageFiducialRMS());
-  if (regist->GetSuccess()){
+  emit displayFrameRMS(rms);
+  if (success){
     emit EnableFrameVisualization();
   }
   else {
     emit DisableFrameVisualization();
   }
+
+  return true;
 }
 
 namespace { // helper functions for json
@@ -600,6 +1067,9 @@ void cbElectrodeController::OpenPlan(const QString& file)
     return;
   }
 
+  // loading the images can be cancelled, like opening them directly
+  this->beginCancellable();
+
   if (this->FrameMatrix) {
     this->FrameMatrix->Delete();
     this->FrameMatrix = 0;
@@ -636,6 +1106,7 @@ void cbElectrodeController::OpenPlan(const QString& file)
         if (cbJsonReadTransform(transform, mat)) {
           matrix->DeepCopy(mat);
         }
+        size_t numberOfSecondaries = this->secondaryKeys.size();
         Json::Value vfile = volume["file"];
         if (vfile.isString()) {
           std::string filename = vfile.asString();
@@ -669,10 +1140,29 @@ void cbElectrodeController::OpenPlan(const QString& file)
             this->OpenCTWithMatrix(image_files, matrix);
           }
         }
+        // keep the registration statistics that were saved with the plan
+        Json::Value reglog = volume["registration"];
+        if (reglog.isArray() &&
+            this->secondaryKeys.size() > numberOfSecondaries) {
+          std::string text;
+          for (Json::ArrayIndex k = 0; k < reglog.size(); k++) {
+            text += reglog[k].asString() + "\n";
+          }
+          this->secondaryStats.back() = text;
+        }
+      }
+      if (this->Cancellation.IsCancelled()) {
+        break;
       }
     }
   }
 
+  // don't finish loading the plan if the user cancelled the images
+  if (this->Cancellation.IsCancelled()) {
+    this->cancelled();
+    return;
+  }
+
   Json::Value tags = plan["tags"];
   if (tags.isArray()) {
     vtkSmartPointer<vtkPoints> tagPoints =
@@ -739,6 +1229,7 @@ void cbElectrodeController::OpenPlan(const QString& file)
     }
   }
 
+  this->endCancellable();
   emit jumpToLastStage();
 }
 
@@ -824,7 +1315,6 @@ void cbElectrodeController::SavePlan(const QString& file)
 
   // names of the nifti files here.
   vtkImageNode *mr_node = this->dataManager->FindImageNode(this->dataKey);
-  vtkImageNode *ct_node = this->dataManager->FindImageNode(this->ctKey);
 
   if (mr_node) {
     Json::Value vol;
@@ -849,11 +1339,22 @@ void cbElectrodeController::SavePlan(const QString& file)
     WriteNIFTIImage(image_path, mr_node->GetImage(), mr_node->GetMatrix());
   }
 
-  if (ct_node) {
+  // the first secondary keeps the name used by single-secondary plans
+  for (size_t j = 0; j < this->secondaryKeys.size(); j++) {
+    vtkImageNode *ct_node =
+      this->dataManager->FindImageNode(this->secondaryKeys[j]);
+    if (!ct_node) {
+      continue;
+    }
+
     Json::Value vol;
 
     // ct_path = ct_node->GetFileURL();
-    std::string ct_path = base + "_secondary.nii.gz";
+    std::string ct_path = base + "_secondary";
+    if (j > 0) {
+      ct_path += std::to_string(j + 1);
+    }
+    ct_path += ".nii.gz";
     vol["file"] = ct_path;
 
     double ct_matrix[16];
@@ -865,6 +1366,18 @@ void cbElectrodeController::SavePlan(const QString& file)
     }
     vol["transform"] = array;
 
+    // the per-level registration statistics, one line per level
+    if (j < this->secondaryStats.size() &&
+        !this->secondaryStats[j].empty()) {
+      Json::Value lines(Json::arrayValue);
+      std::istringstream is(this->secondaryStats[j]);
+      std::string line;
+      while (std::getline(is, line)) {
+        lines.append(line);
+      }
+      vol["registration"] = lines;
+    }
+
     volumes.append(vol);
 
     // write the nifti file
@@ -882,181 +1395,275 @@ void cbElectrodeController::SavePlan(const QString& file)
 
 void cbElectrodeController::OpenCTData(const QStringList& files)
 {
-  vtkSmartPointer<vtkImageData> ct_data =
-    vtkSmartPointer<vtkImageData>::New();
-  vtkSmartPointer<vtkMatrix4x4> ct_matrix =
-    vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkSmartPointer<vtkMatrix4x4> mr_matrix =
-    vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkSmartPointer<vtkMatrix4x4> work_matrix =
-    vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkSmartPointer<vtkDICOMMetaData> ct_meta =
-    vtkSmartPointer<vtkDICOMMetaData>::New();
+  QList<QStringList> series;
+  series.append(files);
+  this->OpenSecondaryData(series);
+}
 
-  vtkSmartPointer<vtkStringArray> ct_files =
-    vtkSmartPointer<vtkStringArray>::New();
-  for (int i = 0; i < files.size(); i++) {
-    ct_files->InsertNextValue(files[i].toUtf8());
-  }
+void cbElectrodeController::OpenSecondaryData(
+  const QList<QStringList>& series)
+{
+  this->beginCancellable();
+
+  size_t n = series.size();
+  std::vector<vtkSmartPointer<vtkImageData> > ct_data(n);
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > ct_matrix(n);
+  std::vector<vtkSmartPointer<vtkMatrix4x4> > work_matrix(n);
+  std::vector<vtkSmartPointer<vtkDICOMMetaData> > ct_meta(n);
+
+  for (size_t j = 0; j < n; j++) {
+    emit displayStatus("Loading secondary series " +
+                       QString::number(j + 1) + " of " +
+                       QString::number(n) + "...");
+
+    ct_data[j] = vtkSmartPointer<vtkImageData>::New();
+    ct_matrix[j] = vtkSmartPointer<vtkMatrix4x4>::New();
+    work_matrix[j] = vtkSmartPointer<vtkMatrix4x4>::New();
+    ct_meta[j] = vtkSmartPointer<vtkDICOMMetaData>::New();
+
+    vtkSmartPointer<vtkStringArray> ct_files =
+      vtkSmartPointer<vtkStringArray>::New();
+    const QStringList& files = series[static_cast<int>(j)];
+    for (int i = 0; i < files.size(); i++) {
+      ct_files->InsertNextValue(files[i].toUtf8());
+    }
 
-  ReadImage(ct_files, ct_data, ct_matrix, ct_meta);
-  work_matrix->DeepCopy(ct_matrix);
+    ReadImage(ct_files, ct_data[j], ct_matrix[j], ct_meta[j]);
+    work_matrix[j]->DeepCopy(ct_matrix[j]);
 
-  std::cout << "*** image matrix ***" << std::endl;
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      std::cout << ct_matrix->GetElement(i, j) << " ";
+    std::cout << "*** image matrix ***" << std::endl;
+    for (int i = 0; i < 4; i++) {
+      for (int k = 0; k < 4; k++) {
+        std::cout << ct_matrix[j]->GetElement(i, k) << " ";
+      }
+      std::cout << std::endl;
     }
-    std::cout << std::endl;
   }
-  this->RegisterCT(ct_data, ct_matrix);
 
-  // compute the change in coords due to the registration
-  work_matrix->Invert();
-  vtkMatrix4x4::Multiply4x4(ct_matrix, work_matrix, work_matrix);
-  // finally, put the points into MR data coordinates
+  std::vector<std::string> stats;
+  std::vector<bool> registered;
+  if (!this->RegisterSecondaries(ct_data, ct_matrix, &stats, &registered)) {
+    this->cancelled();
+    return;
+  }
+
   vtkImageNode *mr = this->dataManager->FindImageNode(this->dataKey);
+  vtkSmartPointer<vtkMatrix4x4> mr_matrix =
+    vtkSmartPointer<vtkMatrix4x4>::New();
   mr_matrix->DeepCopy(mr->GetMatrix());
   mr_matrix->Invert();
-  vtkMatrix4x4::Multiply4x4(mr_matrix, work_matrix, work_matrix);
 
+  this->endCancellable();
+
+  for (size_t j = 0; j < n; j++) {
+    // a series that is not aligned with the primary must not be shown
+    if (!registered[j]) {
+      emit displayStatus("Registration of secondary series " +
+                         QString::number(j + 1) +
+                         " failed, so it was not added.");
+      continue;
+    }
+
+    // compute the change in coords due to the registration
+    work_matrix[j]->Invert();
+    vtkMatrix4x4::Multiply4x4(ct_matrix[j], work_matrix[j], work_matrix[j]);
+    // finally, put the points into MR data coordinates
+    vtkMatrix4x4::Multiply4x4(mr_matrix, work_matrix[j], work_matrix[j]);
+
+    const QStringList& files = series[static_cast<int>(j)];
+    if (files.size() > 0) {
+      this->loadTagFile(files[0], work_matrix[j]);
+    }
+
+    this->addSecondary(ct_data[j], ct_matrix[j], ct_meta[j], stats[j]);
+  }
+}
+
+void cbElectrodeController::addSecondary(
+  vtkImageData *data, vtkMatrix4x4 *matrix, vtkDICOMMetaData *meta,
+  const std::string& stats)
+{
   vtkSmartPointer<vtkImageNode> ct_node =
     vtkSmartPointer<vtkImageNode>::New();
 
-  this->dataManager->AddDataNode(ct_node, this->ctKey);
+  vtkDataManager::UniqueKey key;
+  this->dataManager->AddDataNode(ct_node, key);
+  this->secondaryKeys.push_back(key);
+  this->secondaryStats.push_back(stats);
+
+  ct_node->ShallowCopyImage(data);
+  ct_node->SetMatrix(matrix);
+  ct_node->SetMetaData(meta);
 
-  this->dataManager->FindImageNode(this->ctKey)->ShallowCopyImage(ct_data);
-  this->dataManager->FindImageNode(this->ctKey)->SetMatrix(ct_matrix);
-  this->dataManager->FindImageNode(this->ctKey)->SetMetaData(ct_meta);
+  emit DisplayCTData(key);
+}
 
+void cbElectrodeController::loadTagFile(
+  const QString& imageFile, vtkMatrix4x4 *matrix)
+{
   // Check to see if there is a tag file
-  if (files.size() > 0) {
-    QString tagFile;
-    int l = files[0].size();
-    if (files[0].endsWith(".nii", Qt::CaseInsensitive)) {
-      tagFile = files[0].left(l - 4) + ".tag";
-    }
-    else if (files[0].endsWith(".nii.gz", Qt::CaseInsensitive)) {
-      tagFile = files[0].left(l - 7) + ".tag";
-    }
-    if (tagFile.size() > 0) {
-      QFileInfo info(tagFile);
-      if (info.exists()) {
-        // for converting tags from NIFTI to DICOM coords
-        const double flipXY[16] = {
-          -1.0, 0.0, 0.0, 0.0,  0.0, -1.0, 0.0, 0.0,  0.0, 0.0, 1.0, 0.0,
-          0.0, 0.0, 0.0, 1.0
-        };
-        vtkSmartPointer<vtkTransform> ttransform =
-          vtkSmartPointer<vtkTransform>::New();
-        ttransform->PostMultiply();
-        ttransform->Concatenate(flipXY);
-        ttransform->Concatenate(work_matrix);
-        vtkSmartPointer<vtkMNITagPointReader2> treader =
-          vtkSmartPointer<vtkMNITagPointReader2>::New();
-        treader->SetFileName(tagFile.toLocal8Bit().constData());
-
-        vtkSmartPointer<vtkTransformPolyDataFilter> tfilter =
-          vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-        tfilter->SetInputConnection(treader->GetOutputPort());
-        tfilter->SetTransform(ttransform);
-        tfilter->Update();
-
-        vtkSmartPointer<vtkSurfaceNode> tag_node =
-          vtkSmartPointer<vtkSurfaceNode>::New();
-        this->dataManager->AddDataNode(tag_node, this->tagKey);
-        this->dataManager->FindSurfaceNode(this->tagKey)
-          ->ShallowCopySurface(tfilter->GetOutput());
-
-        emit displayTags(this->tagKey);
-      }
-    }
+  QString tagFile;
+  int l = imageFile.size();
+  if (imageFile.endsWith(".nii", Qt::CaseInsensitive)) {
+    tagFile = imageFile.left(l - 4) + ".tag";
+  }
+  else if (imageFile.endsWith(".nii.gz", Qt::CaseInsensitive)) {
+    tagFile = imageFile.left(l - 7) + ".tag";
+  }
+  if (tagFile.size() == 0 || !QFileInfo(tagFile).exists()) {
+    return;
   }
 
-  emit DisplayCTData(this->ctKey);
+  // for converting tags from NIFTI to DICOM coords
+  const double flipXY[16] = {
+    -1.0, 0.0, 0.0, 0.0,  0.0, -1.0, 0.0, 0.0,  0.0, 0.0, 1.0, 0.0,
+    0.0, 0.0, 0.0, 1.0
+  };
+  vtkSmartPointer<vtkTransform> ttransform =
+    vtkSmartPointer<vtkTransform>::New();
+  ttransform->PostMultiply();
+  ttransform->Concatenate(flipXY);
+  ttransform->Concatenate(matrix);
+  vtkSmartPointer<vtkMNITagPointReader2> treader =
+    vtkSmartPointer<vtkMNITagPointReader2>::New();
+  treader->SetFileName(tagFile.toLocal8Bit().constData());
+
+  vtkSmartPointer<vtkTransformPolyDataFilter> tfilter =
+    vtkSmartPointer<vtkTransformPolyDataFilter>::New();
+  tfilter->SetInputConnection(treader->GetOutputPort());
+  tfilter->SetTransform(ttransform);
+  tfilter->Update();
+
+  vtkSmartPointer<vtkSurfaceNode> tag_node =
+    vtkSmartPointer<vtkSurfaceNode>::New();
+  this->dataManager->AddDataNode(tag_node, this->tagKey);
+  this->dataManager->FindSurfaceNode(this->tagKey)
+    ->ShallowCopySurface(tfilter->GetOutput());
+
+  emit displayTags(this->tagKey);
 }
 
-void cbElectrodeController::RegisterCT(vtkImageData *ct_d, vtkMatrix4x4 *ct_m)
+bool cbElectrodeController::RegisterSecondaries(
+  const std::vector<vtkSmartPointer<vtkImageData> >& data,
+  const std::vector<vtkSmartPointer<vtkMatrix4x4> >& matrices,
+  std::vector<std::string> *stats, std::vector<bool> *registered)
 {
-  QString baseStatus = "Registering secondary series to primary.";
+  int n = static_cast<int>(data.size());
+  QString baseStatus = "Registering " + QString::number(n) +
+                       " secondary series to primary.";
   QString finalStatus = "Registration complete.";
-  emit initializeProgress(0, 100);
+
+  // there is no meaningful fraction for concurrent registrations,
+  // so show a busy indicator until they are done
+  emit initializeProgress(0, 0);
   emit displayStatus(baseStatus);
 
   vtkImageNode *mr = this->dataManager->FindImageNode(this->dataKey);
   vtkImageData *mr_d = mr->GetImage();
   vtkMatrix4x4 *mr_m = mr->GetMatrix();
 
-  cbMRIRegistration *regist = cbMRIRegistration::New();
-  regist->SetInputSource(ct_d);
-  regist->SetInputSourceMatrix(ct_m);
-  regist->SetInputTarget(mr_d);
-  regist->SetInputTargetMatrix(mr_m);
-
-  const int levels = 3;
-  const double blurFactors[3] = { 4.0, 2.0, 1.0 };
-
-  regist->Initialize();
-  emit displayProgress(1);
-
   // make a timer
   vtkNew<vtkTimerLog> timer;
   double startTime = timer->GetUniversalTime();
-  double lastTime = startTime;
-
-  // do multi-level registration
-  for (int level = 1; level <= levels; level++) {
-    regist->StartLevel(blurFactors[level-1]);
-
-    double progressSeg = pow(2.0, -(levels - level + 1.0));
-
-    // iterate until regist level is done
-    int iterations = 0;
-    do {
-      ++iterations;
-      int evals = regist->GetNumberOfEvaluations();
-      emit displayStatus(baseStatus + " Level " + QString::number(level) +
-                         ", Iter " + QString::number(iterations) +
-                         " (" + QString::number(evals) + " Evals).");
-      double progressExp = (1.0 - exp(-0.005*evals));
-      int progress = 1 + static_cast<int>(
-        99*(progressSeg*(1.0 + progressExp)));
-      emit displayProgress(progress);
+
+  // each registration runs its starts concurrently, so the number of
+  // series that are registered at once is limited to avoid having more
+  // threads than cores
+  int starts = std::max(this->registrationStarts, 1);
+  QThreadPool pool;
+  pool.setMaxThreadCount(std::max(QThread::idealThreadCount()/starts, 1));
+
+  std::vector<cbMRIRegistration *> registrations(n);
+  std::vector<std::ostringstream> messages(n);
+  // written by the tasks, one element each, so not a vector<bool>
+  std::vector<char> results(n, 0);
+
+  // each task tells this loop when it is done, and the loop quits
+  // after the last one, so the GUI (and cancel button) stay alive
+  QEventLoop loop;
+  int done = 0;
+
+  for (int j = 0; j < n; j++) {
+    // each registration gets its own copy of the primary image header,
+    // since VTK pipeline information cannot be shared between threads
+    vtkSmartPointer<vtkImageData> mr_copy =
+      vtkSmartPointer<vtkImageData>::New();
+    mr_copy->ShallowCopy(mr_d);
+    vtkImageData *ct_d = data[j];
+    vtkMatrix4x4 *ct_m = matrices[j];
+
+    cbMRIRegistration *regist = cbMRIRegistration::New();
+    regist->SetInputSource(ct_d);
+    regist->SetInputSourceMatrix(ct_m);
+    regist->SetInputTarget(mr_copy);
+    regist->SetInputTargetMatrix(mr_m);
+    regist->SetCancellationToken(&this->Cancellation);
+    regist->SetNumberOfStarts(this->registrationStarts);
+    regist->SetLogStream(&messages[j]);
+    registrations[j] = regist;
+
+    char *result = &results[j];
+    pool.start([this, regist, ct_d, ct_m, mr_copy, mr_m, result,
+                &loop, &done, n, baseStatus]() {
+      if (regist->Execute()) {
+        ResliceToPrimary(ct_d, ct_m, mr_copy, mr_m);
+        *result = 1;
+      }
+      // the count is only touched on the GUI thread
+      QMetaObject::invokeMethod(&loop, [this, &loop, &done, n, baseStatus]() {
+        done++;
+        emit displayStatus(baseStatus + " " + QString::number(done) +
+                           " of " + QString::number(n) + " done.");
+        if (done == n) {
+          loop.quit();
+        }
+      }, Qt::QueuedConnection);
+    });
+  }
+
+  emit enableInterface(false);
+  if (n > 0) {
+    loop.exec();
+  }
+  emit enableInterface(true);
+
+  if (this->Cancellation.IsCancelled()) {
+    for (int j = 0; j < n; j++) {
+      delete registrations[j];
     }
-    while (regist->Iterate());
+    return false;
   }
 
-  double newTime = timer->GetUniversalTime();
-  lastTime = newTime;
+  double lastTime = timer->GetUniversalTime();
 
-  regist->Finish();
+  // log where the time went for each of the registrations,
+  // the messages from Execute() include the statistics
+  if (stats) {
+    stats->resize(n);
+  }
+  if (registered) {
+    registered->assign(results.begin(), results.end());
+  }
+  for (int j = 0; j < n; j++) {
+    if (stats) {
+      std::ostringstream os;
+      registrations[j]->PrintStatistics(os);
+      (*stats)[j] = os.str();
+    }
+    this->log(QString("Registration of secondary series ") +
+              QString::number(j + 1) +
+              (results[j] ? ":\n" : " failed:\n") +
+              QString::fromStdString(messages[j].str()));
+    delete registrations[j];
+  }
 
+  emit initializeProgress(0, 100);
   emit displayProgress(100);
   emit displayStatus(finalStatus + " Time: " +
                      QString::number(lastTime - startTime) +
                      " seconds.");
 
-  // Allow the caller get the result of the registration
-  ct_m->DeepCopy(regist->GetModifiedSourceMatrix());
-
-  vtkNew<vtkImageReslice> reslicer;
-  reslicer->SetInterpolationModeToCubic();
-  reslicer->SetInputData(ct_d);
-  reslicer->SetInformationInput(mr_d);
-
-  vtkNew<vtkMatrix4x4> invertedMatrix;
-  invertedMatrix->DeepCopy(ct_m);
-  invertedMatrix->Invert();
-
-  vtkNew<vtkTransform> resliceTransform;
-  resliceTransform->PostMultiply();
-  resliceTransform->Concatenate(mr_m);
-  resliceTransform->Concatenate(invertedMatrix);
-
-  reslicer->SetResliceTransform(resliceTransform);
-  reslicer->Update();
-
-  ct_d->DeepCopy(reslicer->GetOutput());
+  return true;
 }
 
 // Overloaded to include a pre-registered matrix
@@ -1075,39 +1682,9 @@ void cbElectrodeController::OpenCTData(
   ReadImage(ct_files, ct_data, ct_matrix, ct_meta);
 
   vtkImageNode *mr = this->dataManager->FindImageNode(this->dataKey);
-  vtkImageData *mr_d = mr->GetImage();
-  vtkMatrix4x4 *mr_m = mr->GetMatrix();
-
-  vtkSmartPointer<vtkMatrix4x4> registered_m = m;
-
-  vtkNew<vtkImageReslice> reslicer;
-  reslicer->SetInterpolationModeToCubic();
-  reslicer->SetInputData(ct_data);
-  reslicer->SetInformationInput(mr_d);
-
-  vtkNew<vtkMatrix4x4> invertedMatrix;
-  invertedMatrix->DeepCopy(registered_m);
-  invertedMatrix->Invert();
-
-  vtkNew<vtkTransform> resliceTransform;
-  resliceTransform->PostMultiply();
-  resliceTransform->Concatenate(mr_m);
-  resliceTransform->Concatenate(invertedMatrix);
-
-  reslicer->SetResliceTransform(resliceTransform);
-  reslicer->Update();
-
-  ct_data->DeepCopy(reslicer->GetOutput());
-
-  vtkNew<vtkImageNode> ct_node;
-
-  this->dataManager->AddDataNode(ct_node, this->ctKey);
-
-  this->dataManager->FindImageNode(this->ctKey)->ShallowCopyImage(ct_data);
-  this->dataManager->FindImageNode(this->ctKey)->SetMatrix(m);
-  this->dataManager->FindImageNode(this->ctKey)->SetMetaData(ct_meta);
+  ResliceToPrimary(ct_data, m, mr->GetImage(), mr->GetMatrix());
 
-  emit DisplayCTData(this->ctKey);
+  this->addSecondary(ct_data, m, ct_meta);
 }
 
 // For a pre-resampled image
@@ -1125,19 +1702,15 @@ void cbElectrodeController::OpenCTWithMatrix(
 
   ReadImage(ct_files, ct_data, ct_matrix, ct_meta);
 
-  vtkSmartPointer<vtkImageNode> ct_node =
-    vtkSmartPointer<vtkImageNode>::New();
-
-  this->dataManager->AddDataNode(ct_node, this->ctKey);
-
-  this->dataManager->FindImageNode(this->ctKey)->ShallowCopyImage(ct_data);
-  this->dataManager->FindImageNode(this->ctKey)->SetMatrix(m);
-  this->dataManager->FindImageNode(this->ctKey)->SetMetaData(ct_meta);
-
-  emit DisplayCTData(this->ctKey);
+  this->addSecondary(ct_data, m, ct_meta);
 }
 
 void cbElectrodeController::registerAntPost(int s)
 {
   this->useAnteriorPosteriorFiducials = s;
 }
+
+void cbElectrodeController::setRecomputeFrame(int s)
+{
+  this->recomputeFrame = s;
+}
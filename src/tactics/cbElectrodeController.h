@@ -38,17 +38,28 @@
 #define CBELECTRODECONTROLLER_H
 
 #include "cbApplicationController.h"
+#include "cbCancellationToken.h"
 #include "cbProbe.h"
 #include "vtkDataManager.h"
+#include "vtkSmartPointer.h"
 #include "LeksellFiducial.h"
 
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
+#include <QList>
 #include <QString>
+#include <QStringList>
 
+class vtkAlgorithm;
+class vtkObject;
 class vtkImageData;
 class vtkImageStencilData;
 class vtkMatrix4x4;
 class vtkPolyData;
+class vtkDICOMMetaData;
+class QThreadPool;
 
 //! Realization of cbApplicationController to provide Perfusion processing.
 class cbElectrodeController : public cbApplicationController
@@ -66,9 +77,35 @@ public slots:
   void SavePlan(const QString& file);
   void OpenCTData(const QStringList& files);
   void OpenCTData(const QStringList& files, vtkMatrix4x4 *matrix);
+
+  //! Open several secondary series and register them concurrently.
+  /*!
+   *  Each entry in the list holds the files for one series.  The
+   *  registrations run in parallel on the global thread pool, so the
+   *  total time is bounded by the slowest series.
+  */
+  void OpenSecondaryData(const QList<QStringList>& series);
   void requestOpenImage(const QStringList& files);
   void registerAntPost(int s);
 
+  //! Find the frame even if a saved result exists for the series.
+  void setRecomputeFrame(int s);
+
+  //! Stop the image load, frame finding or registration.
+  /*!
+   *  The background brain extraction is only stopped if nothing else
+   *  is running, otherwise it continues until the primary image changes.
+  */
+  void cancel() override;
+
+  //! Extract the brain for the surface pane, if not done already.
+  /*!
+   *  The extraction runs on a thread pool that belongs to the
+   *  controller, and the surface volume is displayed when it finishes.
+   *  If it is cancelled, it can be requested again.
+  */
+  void requestSurfaceVolume();
+
 signals:
   void DisplayCTData(vtkDataManager::UniqueKey k);
   void displayData(vtkDataManager::UniqueKey);
@@ -105,28 +142,146 @@ signals:
   //! Tell the viw to display the surface volume of the brain.
   void displaySurfaceVolume(vtkDataManager::UniqueKey);
 
+  //! Tell the view to display the brain surface mesh.
+  void displayBrainSurface(vtkDataManager::UniqueKey);
+
 private:
   //! Convenience method for adding timestamp to log messages.
   void log(QString m);
 
   //! Build the frame and tell view to display it.
-  void buildAndDisplayFrame(vtkImageData *data, vtkMatrix4x4 *matrix);
-
-  //! Extract the brain volume and tell view to display it.
-  void extractAndDisplaySurface(vtkImageData *data, vtkMatrix4x4 *matrix);
-
-  //! Register the CT data to the MR data.
-  void RegisterCT(vtkImageData *ct_d, vtkMatrix4x4 *ct_m);
+  /*!
+   *  The result is saved for the series, and is reused when the same
+   *  files are opened again unless setRecomputeFrame() is on.
+   *  Returns false if the operation was cancelled.
+  */
+  bool buildAndDisplayFrame(vtkImageData *data, vtkMatrix4x4 *matrix,
+                            const QStringList& files,
+                            vtkDICOMMetaData *meta);
+
+  //! Get the saved frame-finding result for a series, if any.
+  /*!
+   *  The RMS residual of each fiducial is restored to "fiducialRMS".
+   *  Returns false if no result was saved, or if the files have
+   *  changed since the result was saved.
+  */
+  bool loadFrameCache(const QStringList& files, vtkDICOMMetaData *meta,
+                      vtkMatrix4x4 *frameMatrix, bool *success,
+                      std::vector<double> *fiducialRMS);
+
+  //! Save the frame-finding result for a series.
+  void saveFrameCache(const QStringList& files, vtkDICOMMetaData *meta,
+                      vtkMatrix4x4 *frameMatrix, bool success,
+                      const std::vector<double>& fiducialRMS);
+
+  //! Extract the brain, and return a stencil on the image grid.
+  /*!
+   *  Extraction is done on a copy of the image that is downsampled
+   *  to brainExtractionSpacing, if the image voxels are smaller.
+   *  If brainMesh is provided, the brain surface mesh is copied to it.
+   *  This is safe to call from a worker thread, and it reports its
+   *  progress through surfaceStep() and surfaceProgress().
+   *  Returns nullptr if the token was cancelled.
+  */
+  vtkSmartPointer<vtkImageStencilData> extractBrainStencil(
+    vtkImageData *data, cbCancellationToken *token,
+    vtkPolyData *brainMesh = nullptr);
+
+  //! Store the brain mesh and masked volume, and tell view to display them.
+  void displaySurface(vtkImageData *data, vtkMatrix4x4 *matrix,
+                      vtkImageStencilData *stencil, vtkPolyData *brainMesh);
+
+  //! Queue brain extraction for a newly loaded primary image.
+  /*!
+   *  Unless extractSurfaceOnDemand is set, extraction starts in the
+   *  background as soon as control returns to the event loop.  Any
+   *  extraction for a previous image is cancelled.
+  */
+  void scheduleSurfaceExtraction(vtkImageData *data, vtkMatrix4x4 *matrix);
+
+  //! Register each secondary series to the primary series.
+  /*!
+   *  On success, each image is resampled onto the primary image grid
+   *  and each matrix holds the registered position.  The per-level
+   *  registration statistics for each series are stored in "stats",
+   *  and whether each series was registered is stored in "registered",
+   *  if they are not null.
+   *  Returns false if the operation was cancelled.
+  */
+  bool RegisterSecondaries(
+    const std::vector<vtkSmartPointer<vtkImageData> >& data,
+    const std::vector<vtkSmartPointer<vtkMatrix4x4> >& matrices,
+    std::vector<std::string> *stats, std::vector<bool> *registered);
+
+  //! Load the tag file that accompanies a secondary series, if any.
+  void loadTagFile(const QString& imageFile, vtkMatrix4x4 *matrix);
+
+  //! Add a secondary series to the data manager, and display it.
+  void addSecondary(vtkImageData *data, vtkMatrix4x4 *matrix,
+                    vtkDICOMMetaData *meta,
+                    const std::string& stats = std::string());
+
+  //! Start an operation that can be cancelled by the user.
+  void beginCancellable();
+
+  //! Finish an operation that could be cancelled by the user.
+  void endCancellable();
+
+  //! Report that the current operation was cancelled.
+  void cancelled();
+
+  //! Make a filter abortable, and map its progress onto [start,end].
+  /*!
+   *  Progress is reported through displayProgress(), which gives the
+   *  main window a chance to process a click on its cancel button.
+  */
+  void watchFilter(vtkAlgorithm *filter, int start, int end);
+
+  //! Observer for the progress events of watched filters.
+  void filterProgress(vtkObject *caller, unsigned long, void *);
+
+  //! Report the start of a step of the background brain extraction.
+  void surfaceStep(int step, int numberOfSteps);
+
+  //! Observer for the progress of the background brain extraction.
+  /*!
+   *  This is called on the worker thread, and the progress signal is
+   *  queued for the main window.  Nothing is reported while another
+   *  operation is using the progress bar.
+  */
+  void surfaceProgress(vtkObject *caller, unsigned long, void *);
 
   void OpenCTWithMatrix(const QStringList& files, vtkMatrix4x4 *matrix);
   void OpenImageWithMatrix(const QStringList& files, vtkMatrix4x4 *matrix);
 
   vtkDataManager::UniqueKey dataKey;
   vtkDataManager::UniqueKey volumeKey;
-  vtkDataManager::UniqueKey ctKey;
+  vtkDataManager::UniqueKey brainKey;
+  std::vector<vtkDataManager::UniqueKey> secondaryKeys;
+  //! Registration statistics for each secondary, saved with the plan.
+  std::vector<std::string> secondaryStats;
   vtkDataManager::UniqueKey tagKey;
 
   bool useAnteriorPosteriorFiducials;
+  bool recomputeFrame;
+  //! Voxel size for brain extraction, or zero to use the original voxels.
+  double brainExtractionSpacing;
+  //! Wait until the surface pane is maximized before extracting the brain.
+  bool extractSurfaceOnDemand;
+  //! Number of starting poses for registering a secondary series.
+  int registrationStarts;
+
+  cbCancellationToken Cancellation;
+  //! Whether a cancellable operation is running on the GUI thread.
+  std::atomic<bool> CancellableRunning;
+  //! The token for the background brain extraction.
+  std::shared_ptr<cbCancellationToken> SurfaceCancellation;
+  //! The thread for the background brain extraction.
+  QThreadPool *SurfacePool;
+  //! The primary image, until its brain extraction has been started.
+  vtkSmartPointer<vtkImageData> PendingSurfaceData;
+  vtkSmartPointer<vtkMatrix4x4> PendingSurfaceMatrix;
+  int ProgressRange[2];
 
   std::vector<cbProbe> *Plan;
   vtkMatrix4x4 *FrameMatrix;
@@ -54,6 +54,8 @@ cbElectrodeOpenStage::cbElectrodeOpenStage() : cbStage()
       QTextEdit *desc = new QTextEdit;
       QCheckBox *anteriorPosteriorCheck =
         new QCheckBox("Include A/P fiducials to find frame.");
+      QCheckBox *recomputeFrameCheck =
+        new QCheckBox("Find frame again, even if already found.");
       QPushButton *openButton = new QPushButton("&Open Primary");
       QPushButton *openCTButton = new QPushButton("Open Secondary");
 
@@ -76,15 +78,19 @@ cbElectrodeOpenStage::cbElectrodeOpenStage() : cbStage()
       );
 
   anteriorPosteriorCheck->setChecked(false);
+  recomputeFrameCheck->setChecked(false);
 
   connect(openButton, SIGNAL(clicked()), this, SLOT(Execute()));
   connect(anteriorPosteriorCheck, SIGNAL(stateChanged(int)),
           this, SIGNAL(registerAntPost(int)));
+  connect(recomputeFrameCheck, SIGNAL(stateChanged(int)),
+          this, SIGNAL(recomputeFrame(int)));
   connect(openCTButton, SIGNAL(clicked()), this, SLOT(ExecuteCT()));
 
   vertical->setContentsMargins(11, 0, 11, 0);
   vertical->addWidget(desc);
   vertical->addWidget(anteriorPosteriorCheck);
+  vertical->addWidget(recomputeFrameCheck);
   vertical->addWidget(openButton);
   vertical->addWidget(openCTButton);
   vertical->addStretch();
@@ -130,12 +136,13 @@ void cbElectrodeOpenStage::ExecuteCT()
       path = settings.value(folderKey).toString();
   }
   
-  cbQtDicomDirDialog dialog(nullptr, "Open Secondary Series", path);
-  if (!dialog.exec()) {
-    return;
-  }
+  // collect several series, so that they can be registered together
+  QList<QStringList> series =
+    cbQtDicomDirDialog::getSeriesList(nullptr, "Open Secondary Series", &path);
 
-  emit requestOpenCT(dialog.selectedFiles());
+  if (!series.isEmpty()) {
+    emit requestOpenSecondary(series);
+  }
 }
 const char *cbElectrodeOpenStage::getStageName() const
 {
@@ -39,6 +39,8 @@
 
 #include "cbStage.h"
 
+#include <QStringList>
+
 //! Open stage for the application. Provides an interface to open MR data.
 class cbElectrodeOpenStage : public cbStage
 {
@@ -55,11 +57,13 @@ signals:
   void requestOpenImage(const QStringList& files);
   //! Outgoing signal to set whether or not to use the ant/post fiducials.
   void registerAntPost(int s);
-  //! Outgoing signal to open the CT image.
-  void requestOpenCT(const QStringList& files);
+  //! Outgoing signal to find the frame even if it was found before.
+  void recomputeFrame(int s);
+  //! Outgoing signal to open one or more secondary series.
+  void requestOpenSecondary(const QList<QStringList>& series);
 
 public slots:
-  //! Load the CT.
+  //! Load one or more secondary series.
   virtual void ExecuteCT();
 
   //! Actions to perform for the stage.
@@ -71,6 +71,9 @@
 cbElectrodePlanStage::cbElectrodePlanStage()
   : cbStage(), Plan(), catalogue_(this->get_probe_dir())
 {
+  // probe edits are sent to the view at most once per frame
+  this->pendingProbeIndex = -1;
+
   this->widget = new QWidget;
     QVBoxLayout *vertical = new QVBoxLayout;
       QTextEdit *desc = new QTextEdit;
@@ -103,7 +106,8 @@ cbElectrodePlanStage::cbElectrodePlanStage()
           QPushButton *exportButton = new QPushButton("Sa&ve Screenshot");
         QWidget *optionWidget = new QWidget;
           QGroupBox *opacityBox = new QGroupBox;
-            QSpinBox *opacityLabel = new QSpinBox;
+            opacityLayerSelect = new QComboBox;
+            opacitySpin = new QSpinBox;
             opacitySlider = new QSlider;
           QHBoxLayout *precisionLayout = new QHBoxLayout;
             QComboBox *precisionSelect = new QComboBox();
@@ -221,7 +225,8 @@ cbElectrodePlanStage::cbElectrodePlanStage()
   optionWidgetLayout->addStretch();
 
   QFormLayout *opacity_layout = new QFormLayout;
-  opacity_layout->addRow(opacityLabel, opacitySlider);
+  opacity_layout->addRow(opacityLayerSelect);
+  opacity_layout->addRow(opacitySpin, opacitySlider);
   opacity_layout->setFieldGrowthPolicy(QFormLayout::ExpandingFieldsGrow);
   opacity_layout->setAlignment(opacitySlider, Qt::AlignVCenter);
   opacity_layout->setContentsMargins(0,0,6,0);
@@ -235,18 +240,26 @@ cbElectrodePlanStage::cbElectrodePlanStage()
           &cbElectrodePlanStage::opacitySliderChanged);
   connect(opacitySlider,
           &QSlider::valueChanged,
-          opacityLabel,
+          opacitySpin,
           &QSpinBox::setValue);
-  connect(opacityLabel,
+  connect(opacitySpin,
           QOverload<int>::of(&QSpinBox::valueChanged),
           opacitySlider,
           &QSlider::setValue);
+  connect(opacityLayerSelect,
+          QOverload<int>::of(&QComboBox::currentIndexChanged),
+          this,
+          &cbElectrodePlanStage::opacityLayerChanged);
 
   opacitySlider->setMinimum(0);
   opacitySlider->setMaximum(100);
   opacitySlider->setValue(100);
   opacitySlider->setOrientation(Qt::Horizontal);
 
+  // the first entry controls all of the secondary layers together
+  opacityLayerSelect->addItem("All secondary series");
+  opacityValues.append(100);
+
   tabWidget->addTab(planWidget, "&Planning");
   tabWidget->addTab(optionWidget, "&Options");
 
@@ -523,6 +536,9 @@ void cbElectrodePlanStage::RemoveCurrentFromPlan()
     return;
   }
 
+  // Send any queued update while the indices are still valid
+  this->applyPendingProbeUpdate();
+
   QListWidgetItem *item = this->placedList->takeItem(pos);
   delete item;
 
@@ -538,6 +554,9 @@ void cbElectrodePlanStage::CreateProbeRequest(
 {
   this->tabWidget->setEnabled(true);
 
+  // The queued update must reach the view before the new probe
+  this->applyPendingProbeUpdate();
+
   std::string name;
   if (n.empty()) {
     name = this->nameEdit->text().toStdString();
@@ -652,7 +671,6 @@ void cbElectrodePlanStage::updateCurrentProbePosition()
 {
   int pos = this->placedList->currentRow();
   if (pos == -1) {
-    std::cout << "Nothing selected." << std::endl;
     return;
   }
 
@@ -664,13 +682,8 @@ void cbElectrodePlanStage::updateCurrentProbePosition()
   // Update the position in the probe
   this->Plan.at(pos).SetPosition(position);
 
-  // Update the listing
-  QListWidgetItem *item = this->placedList->item(pos);
-
-  QString str(this->Plan.at(pos).ToString().c_str());
-  item->setText(str);
-
-  emit UpdateProbeCallback(pos, this->Plan.at(pos));
+  // The listing and the view are updated on the next frame
+  this->scheduleProbeUpdate(pos);
 }
 
 // Called when a slider has changed. If there is a selection, update the
@@ -679,7 +692,6 @@ void cbElectrodePlanStage::updateCurrentProbeOrientation()
 {
   int pos = this->placedList->currentRow();
   if (pos == -1) {
-    std::cout << "Nothing selected." << std::endl;
     return;
   }
 
@@ -690,11 +702,8 @@ void cbElectrodePlanStage::updateCurrentProbeOrientation()
   // Update the orientation in the probe
   this->Plan.at(pos).SetOrientation(orientation);
 
-  // Update the listing
-  QListWidgetItem *item = this->placedList->item(pos);
-  item->setText(QString(this->Plan.at(pos).ToString().c_str()));
-
-  emit UpdateProbeCallback(pos, this->Plan.at(pos));
+  // The listing and the view are updated on the next frame
+  this->scheduleProbeUpdate(pos);
 }
 
 void cbElectrodePlanStage::savePlanReport()
@@ -795,6 +804,9 @@ void cbElectrodePlanStage::updateCurrentProbeName(QString n)
 
 void cbElectrodePlanStage::ClearCurrentPlan()
 {
+  // a queued update would be for a probe that is about to be destroyed
+  this->pendingProbeIndex = -1;
+
   // iterate through the plan (FROM THE END) destroying all probes
   for (int i = this->Plan.size()-1; i >= 0; i--) {
     emit DestroyProbeCallback(i);
@@ -819,13 +831,8 @@ void cbElectrodePlanStage::updateCurrentProbeType(QString n)
   cbProbeSpecification s = this->catalogue_.specification(n.toStdString());
   this->Plan.at(pos).set_specification(s);
 
-  // Update the listing
-  QListWidgetItem *item = this->placedList->item(pos);
-
-  QString str(this->Plan.at(pos).ToString().c_str());
-  item->setText(str);
-
-  emit UpdateProbeCallback(pos, this->Plan.at(pos));
+  // The listing and the view are updated on the next frame
+  this->scheduleProbeUpdate(pos);
 }
 
 std::string cbElectrodePlanStage::get_probe_dir()
@@ -854,7 +861,53 @@ void cbElectrodePlanStage::opacitySliderChanged(int o)
 {
   int max = this->opacitySlider->maximum();
   double val = static_cast<double>(o)/static_cast<double>(max);
-  emit SetCTOpacity(val);
+  int layer = this->opacityLayerSelect->currentIndex();
+  if (layer <= 0) {
+    // setting all layers overrides the individual values
+    for (int i = 0; i < this->opacityValues.size(); i++) {
+      this->opacityValues[i] = o;
+    }
+    emit SetCTOpacity(val);
+  }
+  else {
+    this->opacityValues[layer] = o;
+    emit SetSecondaryOpacity(layer - 1, val);
+  }
+}
+
+void cbElectrodePlanStage::opacityLayerChanged(int layer)
+{
+  if (layer < 0 || layer >= this->opacityValues.size()) {
+    return;
+  }
+
+  // show the value for the layer without changing any opacities
+  int o = this->opacityValues[layer];
+  this->opacitySlider->blockSignals(true);
+  this->opacitySpin->blockSignals(true);
+  this->opacitySlider->setValue(o);
+  this->opacitySpin->setValue(o);
+  this->opacitySlider->blockSignals(false);
+  this->opacitySpin->blockSignals(false);
+}
+
+void cbElectrodePlanStage::AddSecondaryLayer(const QString& name)
+{
+  this->opacityLayerSelect->addItem(name);
+  this->opacityValues.append(100);
+}
+
+void cbElectrodePlanStage::ClearSecondaryLayers()
+{
+  // keep the first entry, which controls all of the layers together
+  this->opacityLayerSelect->setCurrentIndex(0);
+  while (this->opacityLayerSelect->count() > 1) {
+    this->opacityLayerSelect->removeItem(1);
+  }
+  this->opacityValues.erase(
+    this->opacityValues.begin() + 1, this->opacityValues.end());
+  this->opacityValues[0] = 100;
+  this->opacityLayerChanged(0);
 }
 
 void cbElectrodePlanStage::setPrecision(QString text)
@@ -910,7 +963,6 @@ void cbElectrodePlanStage::updateCurrentProbeDepth()
 {
   int pos = this->placedList->currentRow();
   if (pos == -1) {
-    std::cout << "Nothing selected." << std::endl;
     return;
   }
 
@@ -925,6 +977,33 @@ void cbElectrodePlanStage::updateCurrentProbeDepth()
   // Update the depth in the probe
   this->Plan.at(pos).SetDepth(depth);
 
+  // The listing and the view are updated on the next frame
+  this->scheduleProbeUpdate(pos);
+}
+
+void cbElectrodePlanStage::scheduleProbeUpdate(int pos)
+{
+  // A queued update for another probe is sent first, so none are lost
+  if (this->pendingProbeIndex != -1 && this->pendingProbeIndex != pos) {
+    this->applyPendingProbeUpdate();
+  }
+  bool wasPending = (this->pendingProbeIndex != -1);
+  this->pendingProbeIndex = pos;
+
+  // the view sends FrameStarting just before it renders the frame
+  if (!wasPending) {
+    emit ProbeUpdatePending();
+  }
+}
+
+void cbElectrodePlanStage::applyPendingProbeUpdate()
+{
+  int pos = this->pendingProbeIndex;
+  this->pendingProbeIndex = -1;
+  if (pos < 0 || pos >= static_cast<int>(this->Plan.size())) {
+    return;
+  }
+
   // Update the listing
   QListWidgetItem *item = this->placedList->item(pos);
 
@@ -42,12 +42,14 @@
 #include "cbStage.h"
 
 #include <vector>
+#include <QList>
 
 class QComboBox;
 class QLineEdit;
 class QListWidget;
 class QSlider;
 class QDoubleSpinBox;
+class QSpinBox;
 class QTabWidget;
 
 //! Plan stage for the application. Provides a pipeline description.
@@ -69,14 +71,19 @@ signals:
   void CreateProbeCallback(cbProbe);
   //! Outgoing signal to update probe positions in the view.
   void UpdateProbeCallback(int index, cbProbe p);
+  //! Outgoing signal to ask for a frame, to apply a queued probe update.
+  void ProbeUpdatePending();
   //! Outgoing signal to destroy a probe from the renderer.
   void DestroyProbeCallback(int);
   //! Outgoing signal to bind pick action for placing probe.
   void InitiatePlaceProbeCallback();
 
-  //! Outgoing signal to set the CT layer opacity.
+  //! Outgoing signal to set the opacity of all secondary layers.
   void SetCTOpacity(double o);
 
+  //! Outgoing signal to set the opacity of one secondary layer.
+  void SetSecondaryOpacity(int layer, double o);
+
   //! Outgoing signal to toggle frame visualization.
   void EnableFrameVisualization();
   void DisableFrameVisualization();
@@ -122,6 +129,18 @@ public slots:
   void CreateProbeRequest(double x, double y, double z, double a, double d,
                           double depth, std::string n, std::string s);
 
+  //! Incoming signal to add a secondary layer to the opacity controls.
+  void AddSecondaryLayer(const QString& name);
+
+  //! Incoming signal to remove all secondary layers from the controls.
+  void ClearSecondaryLayers();
+
+  //! Send the queued probe update to the view.
+  /*!
+   *  The view calls this just before it renders a frame.
+  */
+  void applyPendingProbeUpdate();
+
 private slots:
   void updateForCurrentSelection();
   void updateCurrentProbeOrientation();
@@ -133,6 +152,7 @@ private slots:
   void updateDepthSpinBoxInt(int);
 
   void opacitySliderChanged(int);
+  void opacityLayerChanged(int);
   void setPrecision(QString);
   void toggleFrameVisualization(int);
   void toggleTagVisualization(int);
@@ -144,6 +164,13 @@ private slots:
 private:
   void computeDepthVector(double depth, double vector[3]) const;
 
+  //! Queue an update of the probe, to be sent on the next frame.
+  /*!
+   *  Any number of changes to the same probe within one frame are sent
+   *  to the view as one update.
+   */
+  void scheduleProbeUpdate(int pos);
+
   QLineEdit *nameEdit;
   QComboBox *typeList;
   QListWidget *placedList;
@@ -151,6 +178,10 @@ private:
   QSlider *declinationSlider;
   QSlider *azimuthSlider;
   QSlider *opacitySlider;
+  QSpinBox *opacitySpin;
+  QComboBox *opacityLayerSelect;
+  //! Slider value for each entry in opacityLayerSelect.
+  QList<int> opacityValues;
 
   int sliderSubdivisions;
   int spinBoxDecimals;
@@ -163,6 +194,9 @@ private:
 
   QTabWidget *tabWidget;
 
+  //! The probe with an update for the next frame, or -1 if none.
+  int pendingProbeIndex;
+
   std::vector<cbProbe> Plan;
   cbProbeCatalogue catalogue_;
 
@@ -55,6 +55,7 @@
 #include <QString>
 #include <QStringList>
 #include <QTextStream>
+#include <QTimer>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QMenu>
@@ -70,60 +71,68 @@
 #include "vtkCollection.h"
 #include "vtkColorTransferFunction.h"
 #include "vtkCommand.h"
-#include "vtkContourToPolygonFilter.h"
 #include "vtkCornerAnnotation.h"
-#include "vtkCutter.h"
 #include "vtkDICOMMetaData.h"
 #include "vtkDICOMValue.h"
 #include "vtkDataManager.h"
 #include "vtkDataSetMapper.h"
+#include "vtkDoubleArray.h"
 #include "vtkDummyViewPane.h"
 #include "vtkDynamicViewFrame.h"
 #include "vtkExtractEdges.h"
 #include "vtkErrorCode.h"
+#include "vtkDataArray.h"
 #include "vtkFiducialPointsTool.h"
+#include "vtkFixedPointVolumeRayCastMapper.h"
 #include "vtkFollower.h"
 #include "vtkFollowerPlane.h"
 #include "vtkGlyph3D.h"
+#include "vtkGPUVolumeRayCastMapper.h"
+#include "vtkGlyph3DMapper.h"
 #include "vtkImageData.h"
-#include "vtkImageHistogramStatistics.h"
 #include "vtkImageImport.h"
 #include "vtkImageNode.h"
 #include "vtkSurfaceNode.h"
 #include "vtkImageProperty.h"
 #include "vtkImageReslice.h"
+#include "vtkImageResize.h"
 #include "vtkImageResliceMapper.h"
 #include "vtkImageSlice.h"
 #include "vtkImageStack.h"
+#include "vtkImageStencilData.h"
 #include "vtkImageViewPane.h"
 #include "vtkIntArray.h"
 #include "vtkInteractorStyleImage.h"
 #include "vtkLinearTransform.h"
+#include "vtkLODActor.h"
+#include "vtkLODProp3D.h"
 #include "vtkLookupTable.h"
+#include "vtkMapperCollection.h"
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
-#include "vtkOutlineSource.h"
 #include "vtkPNGWriter.h"
 #include "vtkPanCameraTool.h"
 #include "vtkPiecewiseFunction.h"
 #include "vtkPlane.h"
 #include "vtkPlaneCollection.h"
 #include "vtkPointData.h"
+#include "vtkPoints.h"
 #include "vtkPolyDataMapper.h"
+#include "vtkPolyDataNormals.h"
 #include "vtkProperty.h"
 #include "vtkPushPlaneTool.h"
+#include "vtkQuadricDecimation.h"
 #include "vtkRenderWindow.h"
 #include "vtkRenderer.h"
 #include "vtkRotateCameraTool.h"
 #include "vtkSliceImageTool.h"
 #include "vtkSmartPointer.h"
-#include "vtkSmartVolumeMapper.h"
 #include "vtkSphereSource.h"
-#include "vtkStripper.h"
 #include "vtkTextProperty.h"
 #include "vtkToolCursor.h"
 #include "vtkTransform.h"
 #include "vtkTubeFilter.h"
+#include "vtkUnsignedCharArray.h"
 #include "vtkVectorText.h"
 #include "vtkViewPane.h"
 #include "vtkViewRect.h"
@@ -135,6 +144,10 @@
 
 // SYSTEM INCLUDES
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <sstream>
 #include <iostream>
 
@@ -143,8 +156,21 @@ namespace cb {
   bool arrays_equal(T *a, T *b, size_t size);
 } /* namespace cb */
 
+// Window/level presets, as percentiles of the primary image histogram.
+// The brain and vessel presets only count voxels within the brain mask.
+static const struct {
+  const char *Name;
+  double Lower;
+  double Upper;
+  bool UseStencil;
+} cbAutoWindowPresets[] = {
+  { QT_TRANSLATE_NOOP("cbElectrodeView", "&Brain"), 1.0, 99.0, true },
+  { QT_TRANSLATE_NOOP("cbElectrodeView", "B&one"), 90.0, 99.9, false },
+  { QT_TRANSLATE_NOOP("cbElectrodeView", "&Vessels"), 95.0, 99.8, true },
+};
+
 cbElectrodeView::cbElectrodeView(vtkDataManager *dataManager, QWidget *parent)
-: cbMainWindow(dataManager, parent), dataKey(), ctKey(), SaveFile(), SavedState(false), SelectedIndex(0)
+: cbMainWindow(dataManager, parent), dataKey(), secondaryKeys(), SaveFile(), SavedState(false), SelectedIndex(0)
 {
   this->resize(QGuiApplication::primaryScreen()->size());
   
@@ -172,7 +198,51 @@ cbElectrodeView::cbElectrodeView(vtkDataManager *dataManager, QWidget *parent)
   this->SavedState = true;
 
   this->ImageProperty = vtkImageProperty::New();
-  this->CTProperty = vtkImageProperty::New();
+
+  // the surface volume is resampled if it would exceed this many voxels
+  QSettings settings;
+  this->SurfaceVolumeSpacing = 0.0;
+  this->SurfaceVolumeVoxelLimit =
+    settings.value("surfaceVolumeVoxelLimit", 16777216.0).toDouble();
+
+  // while rotating, the surface pane is coarsened to fit this frame time
+  this->SurfaceFrameTimeTarget =
+    settings.value("surfaceFrameTime", 0.04).toDouble();
+  this->SurfaceImageSampleDistance = 2.0;
+  this->SurfaceInteractive = false;
+  this->SurfaceIdleTimer = new QTimer(this);
+  this->SurfaceIdleTimer->setSingleShot(true);
+  this->SurfaceIdleTimer->setInterval(250);
+  connect(this->SurfaceIdleTimer, SIGNAL(timeout()),
+          this, SLOT(SurfaceIdle()));
+
+  // the brain mesh is shown, unless volume rendering was requested
+  this->BrainSurfaceFullLOD = -1;
+  this->VolumeRenderSurface =
+    settings.value("surfaceVolumeRendering", false).toBool();
+  this->VolumeRenderAction->setChecked(this->VolumeRenderSurface);
+
+  // while a tool cursor is dragged, the slices are drawn more cheaply
+  this->SliceInteractiveInterpolation =
+    settings.value("sliceInteractiveInterpolation",
+                   VTK_LINEAR_INTERPOLATION).toInt();
+  this->SliceInteractiveResample =
+    settings.value("sliceInteractiveResample", true).toBool();
+  this->SliceInteractive = false;
+
+  // observed once here, since the tools are re-bound for each workspace
+  this->viewRect->AddObserver(vtkCommand::StartInteractionEvent, this,
+    &cbElectrodeView::SliceInteractionCallback);
+  this->viewRect->AddObserver(vtkCommand::EndInteractionEvent, this,
+    &cbElectrodeView::SliceInteractionCallback);
+
+  // large plans draw their passive probes as instances, zero disables it
+  this->ProbeBatchThreshold =
+    settings.value("probeBatchThreshold", 8).toInt();
+
+  // held-back edits, e.g. to probes, are applied just before a render
+  this->viewRect->AddObserver(vtkViewRect::PendingRenderEvent, this,
+    &cbElectrodeView::PendingRenderCallback);
 
   this->viewRect->Start();
 }
@@ -191,12 +261,16 @@ void cbElectrodeView::displayData(vtkDataManager::UniqueKey k)
   auto renderer = planar->GetRenderer();
   for (auto &slice : this->Slices) {
       renderer->RemoveViewProp(slice.Stack);
-      renderer->RemoveViewProp(slice.Border);
-      renderer->RemoveViewProp(slice.Intersect);
   }
+  renderer->RemoveViewProp(this->SliceLines);
   this->surface->RemoveAllViewProps();
+  this->BrainSurface = nullptr;
+  this->SurfaceVolume = nullptr;
+  this->SurfaceMapper = nullptr;
+  this->surfaceVolumeKey = vtkDataManager::UniqueKey();
 
   this->Slices.clear();
+  this->ClearSecondaryLayers();
 
   vtkImageNode *primary_node = this->dataManager->FindImageNode(k);
   vtkImageData *data = primary_node->GetImage();
@@ -242,7 +316,7 @@ void cbElectrodeView::displayData(vtkDataManager::UniqueKey k)
   // This ensures that a few abnormally bright pixels will not
   // cause the Window/Level to be miscalculated.
   double range[2];
-  cbElectrodeView::ComputePercentileRange(data, 99.0, range);
+  cbElectrodeView::ComputePercentileRange(primary_node, 99.0, range);
   property->SetColorWindow(range[1]-range[0]);
   property->SetColorLevel(0.5*(range[1]+range[0]));
   property->SetInterpolationTypeToCubic();
@@ -296,64 +370,33 @@ void cbElectrodeView::displayData(vtkDataManager::UniqueKey k)
     this->Slices[i].DataPlane->InvertFollowMatrixOn();
   }
 
-  // This loop adds the borders and configures the focal point of the planes
+  // The borders and intersections are drawn within the image bounds,
+  // expanded by a small tolerance value
+  this->GetImageSlice(0, 0)->GetMapper()->GetBounds(this->SliceLineBounds);
+  for (int j = 0; j < 3; j++) {
+    const double e = 1e-3;
+    this->SliceLineBounds[2*j] -= e;
+    this->SliceLineBounds[2*j + 1] += e;
+  }
+
+  vtkNew<vtkPolyDataMapper> sliceLineMapper;
+  sliceLineMapper->SetInputData(this->SliceLineData);
+  sliceLineMapper->SetScalarModeToUseCellData();
+  sliceLineMapper->SetColorModeToDirectScalars();
+
+  this->SliceLines->SetMapper(sliceLineMapper);
+  this->SliceLines->SetUserMatrix(matrix);
+  this->SliceLines->SetVisibility(1);
+  this->SliceLines->SetPickable(0);
+  this->SliceLineTime = 0;
+  this->buildSliceLines();
+  planar->GetRenderer()->AddActor(this->SliceLines);
+
+  // This loop configures the focal point of the planes
   for (int i = 0; i < 3; i++) {
     // At this point, the orthogonal plane (i) has been created
     vtkImageSlice *image = this->GetImageSlice(0, i);
 
-    // Create an outline that will be cut to create the borders
-    double bounds[6];
-    image->GetMapper()->GetBounds(bounds);
-    for (int j = 0; j < 3; j++) {
-      // expand the bounds by a small tolerance value
-      const double e = 1e-3;
-      bounds[2*j] -= e;
-      bounds[2*j + 1] += e;
-    }
-    vtkNew<vtkOutlineSource> planeOutlineSource;
-    planeOutlineSource->GenerateFacesOn();
-    planeOutlineSource->SetBounds(bounds);
-
-    vtkNew<vtkCutter> planeBorderCutter;
-    planeBorderCutter->SetInputConnection(planeOutlineSource->GetOutputPort());
-    planeBorderCutter->SetCutFunction(this->Slices[i].DataPlane);
-
-    vtkNew<vtkDataSetMapper> planeBorderMapper;
-    planeBorderMapper->SetInputConnection(planeBorderCutter->GetOutputPort());
-
-    vtkSmartPointer<vtkActor> planeBorderActor = this->Slices[i].Border;
-    planeBorderActor->SetUserMatrix(matrix);
-    planeBorderActor->SetVisibility(1);
-    planeBorderActor->SetPickable(0);
-    planeBorderActor->GetProperty()->BackfaceCullingOn();
-    planeBorderActor->GetProperty()->SetColor(0.2, 0.3, 0.3);
-    planeBorderActor->SetMapper(planeBorderMapper);
-
-    // Add the plane outline actor to the scene
-    planar->GetRenderer()->AddActor(planeBorderActor);
-
-    // Create the intersecting lines/borders
-    vtkNew<vtkContourToPolygonFilter> ctp;
-    vtkNew<vtkCutter> ctpC;
-    vtkNew<vtkStripper> ctpS;
-    vtkNew<vtkPolyDataMapper> ctpM;
-    vtkSmartPointer<vtkActor> ctpA = this->Slices[i].Intersect;
-
-    ctp->SetInputData(planeBorderCutter->GetOutput());
-    ctpC->SetInputConnection(ctp->GetOutputPort());
-    ctpC->SetCutFunction(this->Slices[(i + 1)%3].DataPlane);
-    ctpS->SetInputConnection(ctpC->GetOutputPort());
-    ctpM->SetInputConnection(ctpS->GetOutputPort());
-
-    // Configure the actor
-    ctpA->SetMapper(ctpM);
-    ctpA->SetUserMatrix(matrix);
-    ctpA->SetVisibility(1);
-    ctpA->SetPickable(0);
-    ctpA->GetProperty()->BackfaceCullingOn();
-    ctpA->GetProperty()->SetColor(0.5, 0.0, 0.0);
-    planar->GetRenderer()->AddActor(ctpA);
-
      // Set the pane's focal point to be the discovered point
     std::array<vtkImageViewPane*, 3> panes = { sagittalPane, coronalPane, axialPane };
     vtkImageViewPane* currentPane = panes[i];
@@ -550,7 +593,7 @@ void cbElectrodeView::displayData(vtkDataManager::UniqueKey k)
   planar->GetRenderer()->AddViewProp(annotation);
 
   this->resetViewOrientations();
-  viewRect->Start();
+  viewRect->RequestStart();
 
   this->SetSavedState(false);
 }
@@ -573,7 +616,7 @@ void cbElectrodeView::SetOrientationToAxial(vtkRenderer *r)
   this->FixCameraPosition(c);
   this->SetClippingRange(c);
 
-  viewRect->Start();
+  viewRect->RequestStart();
 }
 
 void cbElectrodeView::SetOrientationToSagittal(vtkRenderer *r)
@@ -594,7 +637,7 @@ void cbElectrodeView::SetOrientationToSagittal(vtkRenderer *r)
   this->FixCameraPosition(c);
   this->SetClippingRange(c);
 
-  viewRect->Start();
+  viewRect->RequestStart();
 }
 
 void cbElectrodeView::SetOrientationToCoronal(vtkRenderer *r)
@@ -615,7 +658,175 @@ void cbElectrodeView::SetOrientationToCoronal(vtkRenderer *r)
   this->FixCameraPosition(c);
   this->SetClippingRange(c);
 
-  viewRect->Start();
+  viewRect->RequestStart();
+}
+
+void cbElectrodeView::SliceLinesCallback(vtkObject *, unsigned long, void *)
+{
+  if (this->Slices.size() != 3) {
+    return;
+  }
+
+  // only rebuild if a slice or the frame matrix has moved
+  vtkMTimeType t = this->frameTransform->GetMTime();
+  for (auto &slice : this->Slices) {
+    t = std::max(t, slice.WorldPlane->GetMTime());
+  }
+  if (t > this->SliceLineTime) {
+    this->buildSliceLines();
+  }
+}
+
+void cbElectrodeView::buildSliceLines()
+{
+  const double *bounds = this->SliceLineBounds;
+
+  // Bring the world planes into data coordinates: points are mapped by
+  // the inverse of the matrix, so normals are mapped by its transpose
+  double origin[3][3];
+  double normal[3][3];
+  vtkMatrix4x4 *matrix = this->frameTransform;
+  vtkNew<vtkMatrix4x4> inverse;
+  vtkMatrix4x4::Invert(matrix, inverse);
+
+  this->SliceLineTime = matrix->GetMTime();
+  for (int i = 0; i < 3; i++) {
+    vtkPlane *plane = this->Slices[i].WorldPlane;
+    this->SliceLineTime = std::max(this->SliceLineTime, plane->GetMTime());
+
+    double p[4] = { 0.0, 0.0, 0.0, 1.0 };
+    plane->GetOrigin(p);
+    inverse->MultiplyPoint(p, p);
+    double n[3];
+    plane->GetNormal(n);
+    for (int j = 0; j < 3; j++) {
+      origin[i][j] = p[j];
+      normal[i][j] = (matrix->GetElement(0, j)*n[0] +
+                      matrix->GetElement(1, j)*n[1] +
+                      matrix->GetElement(2, j)*n[2]);
+    }
+    vtkMath::Normalize(normal[i]);
+  }
+
+  vtkNew<vtkPoints> points;
+  vtkNew<vtkCellArray> lines;
+  vtkNew<vtkUnsignedCharArray> colors;
+  colors->SetNumberOfComponents(3);
+
+  // Each border is the polygon where a plane cuts the edges of the box
+  for (int i = 0; i < 3; i++) {
+    double corners[8][3];
+    double distance[8];
+    for (int k = 0; k < 8; k++) {
+      corners[k][0] = bounds[(k & 1)];
+      corners[k][1] = bounds[2 + ((k >> 1) & 1)];
+      corners[k][2] = bounds[4 + ((k >> 2) & 1)];
+      double v[3];
+      vtkMath::Subtract(corners[k], origin[i], v);
+      distance[k] = vtkMath::Dot(normal[i], v);
+    }
+
+    std::vector<std::array<double, 3> > polygon;
+    for (int k = 0; k < 8; k++) {
+      for (int bit = 1; bit < 8; bit <<= 1) {
+        int l = (k | bit);
+        if (l == k || (distance[k] > 0) == (distance[l] > 0)) {
+          continue;
+        }
+        double t = distance[k]/(distance[k] - distance[l]);
+        std::array<double, 3> x;
+        for (int j = 0; j < 3; j++) {
+          x[j] = corners[k][j] + t*(corners[l][j] - corners[k][j]);
+        }
+        polygon.push_back(x);
+      }
+    }
+    if (polygon.size() < 3) {
+      continue;
+    }
+
+    // The polygon is convex, so order its vertices by angle
+    double center[3] = { 0.0, 0.0, 0.0 };
+    for (auto &x : polygon) {
+      vtkMath::Add(center, x.data(), center);
+    }
+    vtkMath::MultiplyScalar(center, 1.0/polygon.size());
+    double u[3], v[3];
+    vtkMath::Perpendiculars(normal[i], u, v, 0.0);
+    std::sort(polygon.begin(), polygon.end(),
+      [&](const std::array<double, 3> &a, const std::array<double, 3> &b) {
+        double da[3], db[3];
+        vtkMath::Subtract(a.data(), center, da);
+        vtkMath::Subtract(b.data(), center, db);
+        return (atan2(vtkMath::Dot(da, v), vtkMath::Dot(da, u)) <
+                atan2(vtkMath::Dot(db, v), vtkMath::Dot(db, u)));
+      });
+
+    vtkIdType first = points->GetNumberOfPoints();
+    for (auto &x : polygon) {
+      points->InsertNextPoint(x.data());
+    }
+    lines->InsertNextCell(static_cast<int>(polygon.size() + 1));
+    for (size_t k = 0; k < polygon.size(); k++) {
+      lines->InsertCellPoint(first + k);
+    }
+    lines->InsertCellPoint(first);
+    colors->InsertNextTuple3(0.2*255, 0.3*255, 0.3*255);
+  }
+
+  // Each pair of planes meets along a line, which is clipped to the box
+  for (int i = 0; i < 3; i++) {
+    const double *n1 = normal[i];
+    const double *n2 = normal[(i + 1)%3];
+    double d[3];
+    vtkMath::Cross(n1, n2, d);
+    double dd = vtkMath::Dot(d, d);
+    if (dd < 1e-12) {
+      continue;
+    }
+
+    // The point on the line that is closest to the coordinate origin
+    double h1 = vtkMath::Dot(n1, origin[i]);
+    double h2 = vtkMath::Dot(n2, origin[(i + 1)%3]);
+    double c1[3], c2[3], p[3];
+    vtkMath::Cross(n2, d, c1);
+    vtkMath::Cross(d, n1, c2);
+    for (int j = 0; j < 3; j++) {
+      p[j] = (h1*c1[j] + h2*c2[j])/dd;
+    }
+
+    double tmin = -VTK_DOUBLE_MAX;
+    double tmax = VTK_DOUBLE_MAX;
+    for (int j = 0; j < 3 && tmin <= tmax; j++) {
+      if (fabs(d[j]) < 1e-12) {
+        if (p[j] < bounds[2*j] || p[j] > bounds[2*j + 1]) {
+          tmax = tmin - 1.0;
+        }
+        continue;
+      }
+      double t1 = (bounds[2*j] - p[j])/d[j];
+      double t2 = (bounds[2*j + 1] - p[j])/d[j];
+      tmin = std::max(tmin, std::min(t1, t2));
+      tmax = std::min(tmax, std::max(t1, t2));
+    }
+    if (tmin >= tmax) {
+      continue;
+    }
+
+    vtkIdType ids[2];
+    for (int k = 0; k < 2; k++) {
+      double t = (k == 0 ? tmin : tmax);
+      ids[k] = points->InsertNextPoint(p[0] + t*d[0], p[1] + t*d[1],
+                                       p[2] + t*d[2]);
+    }
+    lines->InsertNextCell(2, ids);
+    colors->InsertNextTuple3(0.5*255, 0.0, 0.0);
+  }
+
+  this->SliceLineData->Initialize();
+  this->SliceLineData->SetPoints(points);
+  this->SliceLineData->SetLines(lines);
+  this->SliceLineData->GetCellData()->SetScalars(colors);
 }
 
 cbElectrodeView::Slice::Slice(const double orientation[3])
@@ -624,8 +835,6 @@ cbElectrodeView::Slice::Slice(const double orientation[3])
   this->Stack->SetActiveLayer(0);
   this->WorldPlane = vtkNew<vtkPlane>();
   this->DataPlane = vtkNew<vtkFollowerPlane>();
-  this->Border = vtkNew<vtkActor>();
-  this->Intersect = vtkNew<vtkActor>();
 
   // Orientation is the original orientation and it will never change,
   // it is used later when we want to reset the slice
@@ -826,7 +1035,7 @@ void cbElectrodeView::resetViewOrientations()
 
   this->viewRect->GetRenderWindow()->SwapBuffersOn();
   this->viewRect->GetRenderWindow()->Frame();
-  this->viewRect->Start();
+  this->viewRect->RequestStart();
 }
 
 void cbElectrodeView::FixCameraPosition(vtkCamera *c)
@@ -1017,20 +1226,35 @@ void cbElectrodeView::RotateVolumeCallback(vtkObject *o, unsigned long, void *)
 
   surfaceCamera->SetPosition(position);
   surfaceCamera->SetViewUp(viewUp);
+
+  // keep the surface pane within its frame time while rotating, and
+  // render it at full quality as soon as the rotation pauses
+  if (this->SurfaceInteractive) {
+    this->adaptSurfaceDetail();
+  }
+  else {
+    this->setSurfaceInteractive(true);
+  }
+  this->SurfaceIdleTimer->start();
 }
 
 void cbElectrodeView::MaximizeSurfaceRenderer()
 {
   this->surface->SetViewport(this->planarPort);
   this->planar->GetRenderer()->SetViewport(this->surfacePort);
-  this->viewRect->Start();
+  // the brain might not have been extracted yet
+  emit SurfaceVolumeRequested();
+  // the larger pane might deserve a finer volume, but going back to
+  // the small pane keeps the volume that has already been made
+  this->updateSurfaceVolumeResolution(false);
+  this->viewRect->RequestStart();
 }
 
 void cbElectrodeView::MinimizeSurfaceRenderer()
 {
   this->surface->SetViewport(this->surfacePort);
   this->planar->GetRenderer()->SetViewport(this->planarPort);
-  this->viewRect->Start();
+  this->viewRect->RequestStart();
 }
 
 void cbElectrodeView::ToggleMaximizeSurface()
@@ -1107,7 +1331,7 @@ void cbElectrodeView::displayLeksellFrame(vtkMatrix4x4 *transform)
   actor->SetPosition(0,0,0);
   actor->GetProperty()->SetColor(0.9,0.0,0.8);
   this->planar->GetRenderer()->AddActor(actor);
-  this->viewRect->Start();
+  this->viewRect->RequestStart();
 }
 
 void cbElectrodeView::displayTags(vtkDataManager::UniqueKey k)
@@ -1144,7 +1368,8 @@ void cbElectrodeView::displayTags(vtkDataManager::UniqueKey k)
   planar->GetRenderer()->AddViewProp(this->Tags);
 }
 
-void cbElectrodeView::buildProbeMarker(vtkPolyData *probeData, cbProbe p)
+void cbElectrodeView::buildProbeMarker(vtkPolyData *probeData, cbProbe p,
+                                       int sides, int band)
 {
   assert("Input parameter can't be null!" && probeData);
 
@@ -1183,6 +1408,9 @@ void cbElectrodeView::buildProbeMarker(vtkPolyData *probeData, cbProbe p)
 
   vtkNew<vtkIntArray> colors;
   for (size_t i = 0; i < point_list.size() - 1; i++) {
+    if (band >= 0 && static_cast<int>(table[i%2][0]) != band) {
+      continue;
+    }
     electrodeShaftPoints->InsertNextCell(2);
     electrodeShaftPoints->InsertCellPoint(i);
     electrodeShaftPoints->InsertCellPoint(i + 1);
@@ -1196,24 +1424,157 @@ void cbElectrodeView::buildProbeMarker(vtkPolyData *probeData, cbProbe p)
 
   vtkNew<vtkTubeFilter> electrodeShaft;
   electrodeShaft->SetInputData(electrodeShaftProfile);
-  electrodeShaft->SetNumberOfSides(26);
+  electrodeShaft->SetNumberOfSides(sides);
   electrodeShaft->SetRadius(0.5);
   electrodeShaft->SetCapping(1);
   electrodeShaft->Update();
 
-  probeData->DeepCopy(electrodeShaft->GetOutput());
+  // the filter is discarded, so its output can be taken without a copy
+  probeData->ShallowCopy(electrodeShaft->GetOutput());
+}
+
+const cbElectrodeView::ProbeGeometry &cbElectrodeView::probeGeometry(cbProbe p)
+{
+  std::string key = p.specification().catalogue_number();
+
+  std::map<std::string, ProbeGeometry>::iterator it =
+    this->ProbeGeometryCache.find(key);
+  if (it == this->ProbeGeometryCache.end()) {
+    // the coarse tube is drawn when there is little time for the probes,
+    // such as when many probes are drawn while the view is moving
+    ProbeGeometry geometry;
+    geometry.Full = vtkSmartPointer<vtkPolyData>::New();
+    this->buildProbeMarker(geometry.Full, p, 26);
+    geometry.Coarse = vtkSmartPointer<vtkPolyData>::New();
+    this->buildProbeMarker(geometry.Coarse, p, 8);
+    geometry.Contacts = vtkSmartPointer<vtkPolyData>::New();
+    this->buildProbeMarker(geometry.Contacts, p, 26, 0);
+    geometry.Insulators = vtkSmartPointer<vtkPolyData>::New();
+    this->buildProbeMarker(geometry.Insulators, p, 26, 1);
+    it = this->ProbeGeometryCache.insert(std::make_pair(key, geometry)).first;
+  }
+
+  return it->second;
 }
 
-void cbElectrodeView::displaySurfaceVolume(vtkDataManager::UniqueKey k)
+void cbElectrodeView::setProbeGeometry(vtkLODActor *actor, cbProbe p)
+{
+  const ProbeGeometry &geometry = this->probeGeometry(p);
+
+  vtkPolyDataMapper *mapper =
+    vtkPolyDataMapper::SafeDownCast(actor->GetMapper());
+  if (mapper->GetInput() == geometry.Full) {
+    return;
+  }
+  mapper->SetInputData(geometry.Full);
+
+  vtkMapperCollection *lods = actor->GetLODMappers();
+  lods->InitTraversal();
+  vtkPolyDataMapper *lod =
+    vtkPolyDataMapper::SafeDownCast(lods->GetNextItem());
+  if (lod) {
+    lod->SetInputData(geometry.Coarse);
+  }
+}
+
+void cbElectrodeView::displayBrainSurface(vtkDataManager::UniqueKey k)
 {
-  vtkImageNode *node = this->dataManager->FindImageNode(k);
+  vtkSurfaceNode *node = this->dataManager->FindSurfaceNode(k);
 
   assert("node should not be NULL!" && node);
 
-  vtkSmartPointer<vtkImageData> data = vtkSmartPointer<vtkImageData>::New();
-  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  data = node->GetImage();
-  matrix = this->frameTransform;
+  vtkPolyData *mesh = node->GetSurface();
+
+  // replace the surface from any previously loaded image
+  if (this->BrainSurface) {
+    this->surface->RemoveViewProp(this->BrainSurface);
+    this->BrainSurface = nullptr;
+  }
+
+  if (!mesh || mesh->GetNumberOfPolys() == 0) {
+    return;
+  }
+
+  vtkNew<vtkProperty> property;
+  property->SetColor(1.0, 0.8, 0.7);
+  property->SetSpecular(0.1);
+
+  // each level keeps this fraction of the triangles of the full mesh,
+  // the coarser levels are only used while the camera is moving
+  static const double levels[] = { 1.0, 0.25, 0.05 };
+
+  this->BrainSurface = vtkSmartPointer<vtkLODProp3D>::New();
+  for (double level : levels) {
+    vtkSmartPointer<vtkPolyData> levelMesh = mesh;
+    if (level < 1.0) {
+      vtkNew<vtkQuadricDecimation> decimate;
+      decimate->SetInputData(mesh);
+      decimate->SetTargetReduction(1.0 - level);
+      decimate->VolumePreservationOn();
+      decimate->Update();
+      levelMesh = decimate->GetOutput();
+    }
+
+    vtkNew<vtkPolyDataNormals> normals;
+    normals->SetInputData(levelMesh);
+    normals->SplittingOff();
+    normals->Update();
+
+    vtkNew<vtkPolyDataMapper> mapper;
+    mapper->SetInputData(normals->GetOutput());
+    mapper->ScalarVisibilityOff();
+
+    int id = this->BrainSurface->AddLOD(mapper, property, 0.0);
+    if (level == 1.0) {
+      this->BrainSurfaceFullLOD = id;
+    }
+  }
+
+  this->BrainSurface->AutomaticLODSelectionOff();
+  this->BrainSurface->SetSelectedLODID(this->BrainSurfaceFullLOD);
+  this->BrainSurface->SetUserMatrix(this->frameTransform);
+  this->BrainSurface->SetVisibility(!this->VolumeRenderSurface);
+
+  this->surface->AddViewProp(this->BrainSurface);
+
+  this->viewRect->RequestRender();
+}
+
+void cbElectrodeView::displaySurfaceVolume(vtkDataManager::UniqueKey k)
+{
+  // replace the volume from any previously loaded image
+  if (this->SurfaceVolume) {
+    this->surface->RemoveViewProp(this->SurfaceVolume);
+    this->SurfaceVolume = nullptr;
+    this->SurfaceMapper = nullptr;
+  }
+
+  // the volume is only built when volume rendering is requested
+  this->surfaceVolumeKey = k;
+  if (this->VolumeRenderSurface) {
+    this->createSurfaceVolume();
+  }
+
+  this->addRendererLabel(surface, "Surface Volume View", 0);
+  this->surface->InteractiveOn();
+  this->surface->SetAllocatedRenderTime(0.2);
+
+  this->viewRect->RequestRender();
+}
+
+void cbElectrodeView::createSurfaceVolume()
+{
+  vtkImageNode *node = this->dataManager->FindImageNode(
+    this->surfaceVolumeKey);
+
+  // the brain stencil masks the primary image when it is rendered,
+  // so there is nothing to render until the brain has been extracted
+  if (!node || !node->GetStencil()) {
+    return;
+  }
+
+  vtkImageData *data = node->GetImage();
+  vtkMatrix4x4 *matrix = this->frameTransform;
 
   assert("data should not be NULL!" && data);
   assert("matrix should not be NULL!" && matrix);
@@ -1223,7 +1584,7 @@ void cbElectrodeView::displaySurfaceVolume(vtkDataManager::UniqueKey k)
   vtkNew<vtkPiecewiseFunction> opacity;
 
   double range[2];
-  cbElectrodeView::ComputePercentileRange(data, 98.0, range);
+  cbElectrodeView::ComputePercentileRange(node, 98.0, range, true);
 
   static double table[][5] = {
     { 0.00, 0.0, 0.0, 0.0, 0.0 },
@@ -1244,22 +1605,338 @@ void cbElectrodeView::displaySurfaceVolume(vtkDataManager::UniqueKey k)
   volumeProperty->SetInterpolationTypeToLinear();
   volumeProperty->ShadeOff();
 
-  vtkNew<vtkSmartVolumeMapper> mapper;
-  mapper->SetInputData(data);
-  mapper->SetInteractiveUpdateRate(100000);
+  this->SurfaceVolumeSpacing = 0.0;
+  if (this->UseCPUVolumeRayCast(volumeProperty)) {
+    this->SurfaceMapper =
+      vtkSmartPointer<vtkFixedPointVolumeRayCastMapper>::New();
+  }
+  else {
+    this->SurfaceMapper = vtkSmartPointer<vtkGPUVolumeRayCastMapper>::New();
+  }
+  this->updateSurfaceVolumeResolution(true);
 
+  this->SurfaceVolume = vtkSmartPointer<vtkVolume>::New();
+  this->SurfaceVolume->SetMapper(this->SurfaceMapper);
+  this->SurfaceVolume->SetProperty(volumeProperty);
+  this->SurfaceVolume->SetUserMatrix(matrix);
 
-  vtkNew<vtkVolume> volume;
-  volume->SetMapper(mapper);
-  volume->SetProperty(volumeProperty);
-  volume->SetUserMatrix(matrix);
+  this->surface->AddViewProp(this->SurfaceVolume);
+}
 
-  this->addRendererLabel(surface, "Surface Volume View", 0);
-  this->surface->AddViewProp(volume);
-  this->surface->InteractiveOn();
-  this->surface->SetAllocatedRenderTime(0.2);
+void cbElectrodeView::SetSurfaceVolumeRendering(bool on)
+{
+  this->VolumeRenderSurface = on;
+
+  QSettings settings;
+  settings.setValue("surfaceVolumeRendering", on);
+
+  if (on && !this->SurfaceVolume) {
+    this->createSurfaceVolume();
+  }
+  if (this->SurfaceVolume) {
+    this->SurfaceVolume->SetVisibility(on);
+  }
+  if (this->BrainSurface) {
+    this->BrainSurface->SetVisibility(!on);
+  }
+
+  this->viewRect->RequestRender();
+}
+
+void cbElectrodeView::SurfaceInteractionCallback(
+  vtkObject *, unsigned long event, void *)
+{
+  // the render that follows the end of the drag is at full quality
+  this->SurfaceIdleTimer->stop();
+  this->setSurfaceInteractive(event == vtkCommand::StartInteractionEvent);
+}
+
+void cbElectrodeView::SurfaceIdle()
+{
+  // the mouse button is still down, but the camera has stopped moving
+  if (this->SurfaceInteractive) {
+    this->setSurfaceInteractive(false);
+    this->viewRect->RequestRender();
+  }
+}
+
+void cbElectrodeView::setSurfaceInteractive(bool interactive)
+{
+  this->SurfaceInteractive = interactive;
+
+  // while the camera moves, let the prop choose the finest level that
+  // fits within the allocated render time; at rest, show full detail
+  if (this->BrainSurface) {
+    this->BrainSurface->SetAutomaticLODSelection(interactive);
+    if (!interactive) {
+      this->BrainSurface->SetSelectedLODID(this->BrainSurfaceFullLOD);
+    }
+  }
+
+  this->applySurfaceDetail();
+}
+
+void cbElectrodeView::SliceInteractionCallback(
+  vtkObject *, unsigned long event, void *)
+{
+  // the render that follows the end of the drag is at full quality
+  this->setSliceInteractive(event == vtkCommand::StartInteractionEvent);
+}
+
+void cbElectrodeView::PendingRenderCallback(
+  vtkObject *, unsigned long, void *)
+{
+  emit FrameStarting();
+}
+
+void cbElectrodeView::RequestFrame()
+{
+  this->viewRect->RequestRender();
+}
+
+void cbElectrodeView::setSliceInteractive(bool interactive)
+{
+  if (interactive == this->SliceInteractive) {
+    return;
+  }
+  this->SliceInteractive = interactive;
+
+  // cubic reslicing of every layer is the main cost of a 2D drag
+  int interpolation = VTK_CUBIC_INTERPOLATION;
+  if (interactive) {
+    interpolation = (this->SliceInteractiveInterpolation ==
+                     VTK_NEAREST_INTERPOLATION ?
+                     VTK_NEAREST_INTERPOLATION : VTK_LINEAR_INTERPOLATION);
+  }
+  this->ImageProperty->SetInterpolationType(interpolation);
+  for (size_t i = 0; i < this->SecondaryProperties.size(); i++) {
+    this->SecondaryProperties[i]->SetInterpolationType(interpolation);
+  }
+
+  // the side panes already sample at the image resolution, but the
+  // planar slices are resampled to the screen unless this is relaxed
+  bool resample = (!interactive || this->SliceInteractiveResample);
+  for (size_t i = 0; i < this->Slices.size(); i++) {
+    vtkImageSliceCollection *images = this->Slices[i].Stack->GetImages();
+    vtkCollectionSimpleIterator pit;
+    images->InitTraversal(pit);
+    vtkImageSlice *image = 0;
+    while ((image = images->GetNextImage(pit)) != 0) {
+      vtkImageResliceMapper *mapper =
+        vtkImageResliceMapper::SafeDownCast(image->GetMapper());
+      if (mapper) {
+        mapper->SetResampleToScreenPixels(resample);
+      }
+    }
+  }
+}
+
+void cbElectrodeView::adaptSurfaceDetail()
+{
+  double frameTime = this->surface->GetLastRenderTimeInSeconds();
+  if (frameTime <= 0.0 || this->SurfaceFrameTimeTarget <= 0.0) {
+    return;
+  }
+
+  // the number of rays goes as the inverse square of the image sample
+  // distance, and the change is damped to avoid flicker between sizes
+  double distance = this->SurfaceImageSampleDistance;
+  double ideal = distance*std::sqrt(frameTime/this->SurfaceFrameTimeTarget);
+  distance = 0.5*(distance + ideal);
+  distance = (distance > 1.0 ? distance : 1.0);
+  distance = (distance < 4.0 ? distance : 4.0);
+
+  if (std::fabs(distance - this->SurfaceImageSampleDistance) > 0.1) {
+    this->SurfaceImageSampleDistance = distance;
+    this->applySurfaceDetail();
+  }
+}
+
+void cbElectrodeView::applySurfaceDetail()
+{
+  if (!this->SurfaceMapper || !this->SurfaceMapper->GetInput()) {
+    return;
+  }
+
+  // at rest, every pixel gets a ray with two samples per voxel; while
+  // moving, there is one sample per voxel and fewer rays
+  double spacing[3];
+  this->SurfaceMapper->GetInput()->GetSpacing(spacing);
+  double sampleDistance = 0.5*std::min(spacing[0],
+                                       std::min(spacing[1], spacing[2]));
+  double imageSampleDistance = 1.0;
+  if (this->SurfaceInteractive) {
+    sampleDistance *= 2.0;
+    imageSampleDistance = this->SurfaceImageSampleDistance;
+  }
 
-  this->viewRect->GetRenderWindow()->Render();
+  vtkGPUVolumeRayCastMapper *gpuMapper =
+    vtkGPUVolumeRayCastMapper::SafeDownCast(this->SurfaceMapper);
+  vtkFixedPointVolumeRayCastMapper *cpuMapper =
+    vtkFixedPointVolumeRayCastMapper::SafeDownCast(this->SurfaceMapper);
+  if (gpuMapper) {
+    gpuMapper->AutoAdjustSampleDistancesOff();
+    gpuMapper->SetSampleDistance(sampleDistance);
+    gpuMapper->SetImageSampleDistance(imageSampleDistance);
+  }
+  else if (cpuMapper) {
+    cpuMapper->AutoAdjustSampleDistancesOff();
+    cpuMapper->LockSampleDistanceToInputSpacingOff();
+    cpuMapper->SetSampleDistance(sampleDistance);
+    cpuMapper->SetImageSampleDistance(imageSampleDistance);
+  }
+}
+
+void cbElectrodeView::updateSurfaceVolumeResolution(bool allowCoarser)
+{
+  vtkImageNode *node = this->dataManager->FindImageNode(
+    this->surfaceVolumeKey);
+  if (!this->SurfaceMapper || !node) {
+    return;
+  }
+
+  vtkImageData *data = node->GetImage();
+  vtkImageStencilData *stencil = node->GetStencil();
+
+  // only the region covered by the brain stencil is rendered, and the
+  // stencil extent is the whole grid, so its runs give the brain bounds
+  double origin[3], spacing[3], bounds[6];
+  data->GetOrigin(origin);
+  data->GetSpacing(spacing);
+  data->GetBounds(bounds);
+  if (stencil) {
+    std::vector<int> runs;
+    int inside[6];
+    cbElectrodeView::GetStencilRuns(data, stencil, &runs, inside);
+    for (int i = 0; i < 3; i++) {
+      bounds[2*i] = origin[i] + inside[2*i]*spacing[i];
+      bounds[2*i + 1] = origin[i] + inside[2*i + 1]*spacing[i];
+    }
+  }
+
+  double volume = 1.0;
+  double maxLength = 0.0;
+  for (int i = 0; i < 3; i++) {
+    double length = bounds[2*i + 1] - bounds[2*i] + spacing[i];
+    volume *= length;
+    maxLength = (length > maxLength ? length : maxLength);
+  }
+
+  // voxels that are smaller than a pixel of the pane add nothing
+  double targetSpacing = 0.0;
+  const int *size = this->surface->GetSize();
+  int pixels = (size[0] > size[1] ? size[0] : size[1]);
+  if (pixels > 0) {
+    targetSpacing = maxLength/pixels;
+  }
+
+  // and the number of voxels must fit within the budget
+  if (this->SurfaceVolumeVoxelLimit > 0) {
+    double budgetSpacing = std::cbrt(volume/this->SurfaceVolumeVoxelLimit);
+    targetSpacing = (budgetSpacing > targetSpacing ?
+                     budgetSpacing : targetSpacing);
+  }
+
+  double minSpacing = spacing[0];
+  minSpacing = (spacing[1] < minSpacing ? spacing[1] : minSpacing);
+  minSpacing = (spacing[2] < minSpacing ? spacing[2] : minSpacing);
+  targetSpacing = (targetSpacing > minSpacing ? targetSpacing : minSpacing);
+
+  // skip the resampling unless the resolution changes noticeably
+  if (this->SurfaceVolumeSpacing > 0.0) {
+    double ratio = targetSpacing/this->SurfaceVolumeSpacing;
+    if ((ratio > 1.0 && !allowCoarser) || (ratio > 0.9 && ratio < 1.1)) {
+      return;
+    }
+  }
+  this->SurfaceVolumeSpacing = targetSpacing;
+
+  // render the original image if no axis needs to be resampled
+  vtkSmartPointer<vtkImageData> input = data;
+  if (targetSpacing > 1.01*minSpacing) {
+    double outputSpacing[3];
+    for (int i = 0; i < 3; i++) {
+      outputSpacing[i] = (spacing[i] > targetSpacing ?
+                          spacing[i] : targetSpacing);
+    }
+    vtkNew<vtkImageResize> resize;
+    resize->SetInputData(data);
+    resize->SetResizeMethodToOutputSpacing();
+    resize->SetOutputSpacing(outputSpacing);
+    resize->CroppingOn();
+    resize->SetCroppingRegion(bounds);
+    resize->Update();
+    input = resize->GetOutput();
+  }
+
+  if (!stencil) {
+    this->SurfaceMapper->SetInputData(input);
+    this->applySurfaceDetail();
+    return;
+  }
+
+  double maskBounds[6];
+  vtkGPUVolumeRayCastMapper *gpuMapper =
+    vtkGPUVolumeRayCastMapper::SafeDownCast(this->SurfaceMapper);
+  if (gpuMapper) {
+    // the mapper samples the mask as a texture on the same grid as the
+    // volume, so both are cropped to the stencil bounds, and the mask
+    // is dense only within those bounds
+    vtkNew<vtkImageData> brain;
+    vtkNew<vtkImageData> mask;
+    cbElectrodeView::MakeStencilVolume(input, stencil, brain, maskBounds);
+    cbElectrodeView::MakeStencilMask(input, stencil, mask, maskBounds);
+    gpuMapper->SetInputData(brain);
+    gpuMapper->SetMaskInput(mask);
+    gpuMapper->SetMaskTypeToBinary();
+  }
+  else {
+    // the CPU mapper has no mask input, so it gets only the voxels
+    // within the stencil bounds, and those outside the brain are set
+    // to the minimum, which is transparent; its min/max cells then
+    // let the rays leap over the blocks that are outside the brain
+    vtkNew<vtkImageData> brain;
+    cbElectrodeView::MakeStencilVolume(input, stencil, brain, maskBounds);
+    this->SurfaceMapper->SetInputData(brain);
+  }
+
+  this->SurfaceMapper->CroppingOn();
+  this->SurfaceMapper->SetCroppingRegionPlanes(maskBounds);
+  this->SurfaceMapper->SetCroppingRegionFlagsToSubVolume();
+
+  this->applySurfaceDetail();
+}
+
+bool cbElectrodeView::UseCPUVolumeRayCast(vtkVolumeProperty *property)
+{
+  QSettings settings;
+  QString mode = settings.value("surfaceVolumeRayCast", "auto").toString();
+  if (mode == "cpu") {
+    return true;
+  }
+  else if (mode == "gpu") {
+    return false;
+  }
+
+  vtkRenderWindow *renderWindow = this->viewRect->GetRenderWindow();
+  vtkNew<vtkGPUVolumeRayCastMapper> gpuMapper;
+  if (!gpuMapper->IsRenderSupported(renderWindow, property)) {
+    return true;
+  }
+
+  // software OpenGL can run the GPU mapper, but much more slowly than
+  // the CPU mapper, which skips empty space and uses all the cores
+  static const char *softwareRenderers[] = {
+    "llvmpipe", "softpipe", "Software Rasterizer", "GDI Generic", nullptr
+  };
+  const char *capabilities = renderWindow->ReportCapabilities();
+  for (int i = 0; capabilities && softwareRenderers[i]; i++) {
+    if (strstr(capabilities, softwareRenderers[i])) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 void cbElectrodeView::addRendererLabel(vtkRenderer *r, const char *str,
@@ -1298,7 +1975,7 @@ void cbElectrodeView::ProbePlacementCallback(vtkObject *o, unsigned long, void *
                           90, 90, 0, "", "");
 }
 
-void cbElectrodeView::CreateProbeCallback(cbProbe p)
+void cbElectrodeView::buildProbeMatrix(vtkMatrix4x4 *matrix, cbProbe p)
 {
   double position[3]; double orientation[2];
   p.GetPosition(position);
@@ -1306,35 +1983,6 @@ void cbElectrodeView::CreateProbeCallback(cbProbe p)
 
   double depth = p.GetDepth();
 
-  // Create the poly data
-  vtkNew<vtkPolyData> data;
-  this->buildProbeMarker(data, p);
-
-  vtkNew<vtkPolyDataMapper> mapper;
-  mapper->SetInputData(data);
-
-  static double table[2][4] = {
-    {256.0/256.0, 128.0/256.0, 0.0/256.0, 1.0}, // Fluorescent orange contacts
-    {1.0, 1.0, 1.0, 1.0}, // White insulator
-  };
-
-  vtkNew<vtkLookupTable> active;
-
-  active->SetTableRange(0, 1);
-  active->SetNanColor(1.0, 0.0, 0.0, 1.0);
-  active->SetNumberOfTableValues(2);
-  active->Build();
-  for (int i = 0; i < 2; i++) {
-    active->SetTableValue(i, table[i]);
-  }
-
-  mapper->SetLookupTable(active);
-  mapper->SetScalarModeToUseCellData();
-  mapper->SetScalarVisibility(1);
-
-  vtkNew<vtkActor> actor;
-  actor->SetMapper(mapper);
-
   // Build the transform necessary to build the user matrix for the probes
   vtkNew<vtkTransform> transform;
   transform->PostMultiply();
@@ -1347,151 +1995,218 @@ void cbElectrodeView::CreateProbeCallback(cbProbe p)
   transform->RotateWXYZ(orientation[1], -1.0, 0.0,  0.0);
   transform->Translate(position);
 
-  vtkNew<vtkMatrix4x4> matrix;
   matrix->DeepCopy(transform->GetMatrix());
-
-  // Set the position and orientation for the probe
-  actor->SetUserMatrix(matrix);
-
-  // Add actor to collection
-  this->Probes->AddItem(actor);
-
-  // Add actor to the renderer
-  this->planar->GetRenderer()->AddActor(actor);
-  this->surface->AddActor(actor);
-
-  this->viewRect->Start();
-
-  this->SetSavedState(false);
 }
 
-void cbElectrodeView::UpdateProbeCallback(int index, cbProbe p)
+void cbElectrodeView::setProbeStyle(vtkActor *actor, bool active)
 {
-  vtkNew<vtkPolyData> data;
-  this->buildProbeMarker(data, p);
-
-  vtkNew<vtkPolyDataMapper> mapper;
-
-  vtkNew<vtkActor> actor;
+  vtkLookupTable *table =
+    (active ? this->ActiveProbeTable : this->PassiveProbeTable);
 
-  mapper->SetInputData(data);
-  actor->SetMapper(mapper);
-
-  vtkObject *o = this->Probes->GetItemAsObject(index);
-  vtkActor *a = vtkActor::SafeDownCast(o);
-
-  this->planar->GetRenderer()->RemoveActor(a);
-  this->surface->RemoveActor(a);
+  actor->GetMapper()->SetLookupTable(table);
+  vtkLODActor *lodActor = vtkLODActor::SafeDownCast(actor);
+  if (lodActor) {
+    vtkMapperCollection *lods = lodActor->GetLODMappers();
+    vtkMapper *lod = NULL;
+    for (lods->InitTraversal(); (lod = lods->GetNextItem()); ) {
+      lod->SetLookupTable(table);
+    }
+  }
 
-  this->Probes->ReplaceItem(index, actor);
+  if (active) {
+    // Make active electrode non-metallic
+    actor->GetProperty()->SetAmbient(0.5);
+    actor->GetProperty()->SetDiffuse(0.5);
+    actor->GetProperty()->SetSpecular(0.2);
+    actor->GetProperty()->SetSpecularPower(10);
+    actor->GetProperty()->SetMetallic(0.0);
+  } else {
+    actor->GetProperty()->SetAmbient(0.3);      // Low ambient (less flat)
+    actor->GetProperty()->SetDiffuse(0.6);      // Moderate diffuse
+    actor->GetProperty()->SetSpecular(0.8);     // High specular (shininess)
+    actor->GetProperty()->SetSpecularPower(50); // Tight specular highlight
+    actor->GetProperty()->SetMetallic(0.7);     // Metallic appearance
+  }
+}
 
-  a = actor;
+void cbElectrodeView::setProbeActorDrawn(vtkActor *actor, bool drawn)
+{
+  vtkRenderer *renderers[2] = { this->planar->GetRenderer(), this->surface };
+  for (vtkRenderer *ren : renderers) {
+    bool present = (ren->GetActors()->IsItemPresent(actor) != 0);
+    if (drawn && !present) {
+      ren->AddActor(actor);
+    } else if (!drawn && present) {
+      ren->RemoveActor(actor);
+    }
+  }
+}
 
-  a->GetProperty()->SetAmbient(0.5);
-  a->GetProperty()->SetDiffuse(0.2);
+void cbElectrodeView::updateProbeBatch()
+{
+  int n = this->Probes->GetNumberOfItems();
+  bool batched = (this->ProbeBatchThreshold > 0 &&
+                  n >= this->ProbeBatchThreshold);
 
-  this->planar->GetRenderer()->AddActor(a);
-  this->surface->AddActor(a);
+  vtkGlyph3DMapper *contactMapper =
+    vtkGlyph3DMapper::SafeDownCast(this->ProbeContactBatch->GetMapper());
+  vtkGlyph3DMapper *insulatorMapper =
+    vtkGlyph3DMapper::SafeDownCast(this->ProbeInsulatorBatch->GetMapper());
 
-  if (!a) {
-    std::cout << "Could not find at " << index << std::endl;
+  // Each probe type is one glyph source, which is one instanced draw
+  std::map<vtkDataObject *, int> sourceIndex;
+  int numberOfSources = 0;
+  std::map<std::string, ProbeGeometry>::iterator it;
+  for (it = this->ProbeGeometryCache.begin();
+       it != this->ProbeGeometryCache.end(); ++it) {
+    contactMapper->SetSourceData(numberOfSources, it->second.Contacts);
+    insulatorMapper->SetSourceData(numberOfSources, it->second.Insulators);
+    sourceIndex[it->second.Full] = numberOfSources++;
   }
 
-  // Get the actor collections
-  vtkActorCollection *planar_c = this->planar->GetRenderer()->GetActors();
-  vtkActorCollection *surface_c = this->surface->GetActors();
-
-  // Make sure the actor is present in the collections
-  if (!planar_c->IsItemPresent(a)) {
-    std::cout << "Actor not found in planar!" << std::endl;
-  }
-  if (!surface_c->IsItemPresent(a)) {
-    std::cout << "Actor not found in surface!" << std::endl;
-  }
+  vtkNew<vtkPoints> points;
+  vtkNew<vtkDoubleArray> orientations;
+  orientations->SetName("Orientation");
+  orientations->SetNumberOfComponents(4);
+  vtkNew<vtkIntArray> types;
+  types->SetName("Type");
+  vtkNew<vtkUnsignedCharArray> colors;
+  colors->SetName("Colors");
+  colors->SetNumberOfComponents(3);
+
+  // The passive contact color, per instance so it can be highlighted
+  double passive[4];
+  this->PassiveProbeTable->GetTableValue(0, passive);
 
-  // Cache the index for later use
-  this->SelectedIndex = index;
+  vtkCollectionSimpleIterator iter;
+  this->Probes->InitTraversal(iter);
 
-  // Update the probe's position
-  double position[3];
-  p.GetPosition(position);
+  vtkActor *act = NULL;
+  while ((act = this->Probes->GetNextActor(iter))) {
+    // the active probe, and any new probe that has not been restyled
+    // yet, has the active colors, so it is drawn on its own
+    bool looksActive =
+      (act->GetMapper()->GetLookupTable() == this->ActiveProbeTable);
+    bool inBatch = (batched && !looksActive && act->GetVisibility());
+    this->setProbeActorDrawn(act, !inBatch);
+    if (!inBatch) {
+      continue;
+    }
 
-  // Update the probe's orientation
-  double orientation[2];
-  p.GetOrientation(orientation);
+    // The probe matrix is a rotation followed by a translation
+    vtkMatrix4x4 *matrix = act->GetUserMatrix();
+    double rotation[3][3];
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        rotation[i][j] = matrix->GetElement(i, j);
+      }
+    }
+    double quaternion[4];
+    vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+
+    vtkPolyDataMapper *mapper =
+      vtkPolyDataMapper::SafeDownCast(act->GetMapper());
+
+    points->InsertNextPoint(matrix->GetElement(0, 3),
+                            matrix->GetElement(1, 3),
+                            matrix->GetElement(2, 3));
+    orientations->InsertNextTuple(quaternion);
+    types->InsertNextValue(sourceIndex[mapper->GetInput()]);
+    colors->InsertNextTuple3(255*passive[0], 255*passive[1], 255*passive[2]);
+  }
 
-  // Update the probe's depth
-  double depth = p.GetDepth();
+  this->ProbeInstances->Initialize();
+  this->ProbeInstances->SetPoints(points);
+  this->ProbeInstances->GetPointData()->AddArray(orientations);
+  this->ProbeInstances->GetPointData()->AddArray(types);
+  this->ProbeInstances->GetPointData()->SetScalars(colors);
 
-  // Build the transform necessary to build the user matrix for the probes
-  vtkNew<vtkTransform> transform;
-  transform->PostMultiply();
+  bool drawBatch = (points->GetNumberOfPoints() > 0);
+  this->setProbeActorDrawn(this->ProbeContactBatch, drawBatch);
+  this->setProbeActorDrawn(this->ProbeInsulatorBatch, drawBatch);
+}
 
-  transform->Translate(-1.0*depth, 0.0, 0.0);
+void cbElectrodeView::CreateProbeCallback(cbProbe p)
+{
+  // The full and coarse mappers share the cached polydata
+  vtkNew<vtkPolyDataMapper> mapper;
+  vtkNew<vtkPolyDataMapper> coarseMapper;
+  vtkPolyDataMapper *mappers[2] = { mapper, coarseMapper };
+  for (vtkPolyDataMapper *m : mappers) {
+    m->SetLookupTable(this->ActiveProbeTable);
+    m->SetScalarModeToUseCellData();
+    m->SetScalarVisibility(1);
+  }
 
-  // azimuth = Left-to-Right angle (rotate about -Z axis)
-  // declination = Posterior-to-Anterior angle (rotate about -X axis)
-  transform->RotateWXYZ(orientation[0],  0.0, 0.0, -1.0);
-  transform->RotateWXYZ(orientation[1], -1.0, 0.0,  0.0);
-  transform->Translate(position);
+  vtkNew<vtkLODActor> actor;
+  actor->SetMapper(mapper);
+  actor->AddLODMapper(coarseMapper);
+  this->setProbeGeometry(actor, p);
 
+  // Set the position and orientation for the probe
   vtkNew<vtkMatrix4x4> matrix;
-  matrix->DeepCopy(transform->GetMatrix());
+  this->buildProbeMatrix(matrix, p);
+  actor->SetUserMatrix(matrix);
 
-  // Set the position and orientation for the probe
-  a->SetUserMatrix(matrix);
+  // Add actor to collection
+  this->Probes->AddItem(actor);
 
-  static double active_table[2][4] = {
-    {256.0/256.0, 128.0/256.0, 0.0/256.0, 1.0}, //Fluorescent Orange
-    {1.0, 1.0, 1.0, 1.0}, //White
-  };
+  // The new probe is drawn as active until the next update, which must
+  // then restyle all of the probes
+  this->ActiveProbe = NULL;
 
-  vtkNew<vtkLookupTable> active;
-  active->SetTableRange(0, 1);
-  active->SetNanColor(1.0, 0.0, 0.0, 1.0);
-  active->SetNumberOfTableValues(2);
-  active->Build();
-  active->SetTableValue(0, active_table[0]);
-  active->SetTableValue(1, active_table[1]);
+  // Add actor to the renderer
+  this->planar->GetRenderer()->AddActor(actor);
+  this->surface->AddActor(actor);
+  this->updateProbeBatch();
 
-  a->GetMapper()->SetLookupTable(active);
-  
-  // Make active electrode non-metallic
-  a->GetProperty()->SetAmbient(0.5);
-  a->GetProperty()->SetDiffuse(0.5);
-  a->GetProperty()->SetSpecular(0.2);
-  a->GetProperty()->SetSpecularPower(10);
-  a->GetProperty()->SetMetallic(0.0);
+  this->viewRect->RequestStart();
 
-  static double passive_table[2][4] = {
-    {0.75, 0.75, 0.75, 1.0},
-    {1.0, 1.0, 1.0, 1.0},
-  };
+  this->SetSavedState(false);
+}
 
-  vtkNew<vtkLookupTable> passive;
-  passive->SetTableRange(0, 1);
-  passive->SetNanColor(1.0, 0.0, 0.0, 1.0);
-  passive->SetNumberOfTableValues(2);
-  passive->Build();
-  passive->SetTableValue(0, passive_table[0]);
-  passive->SetTableValue(1, passive_table[1]);
+void cbElectrodeView::UpdateProbeCallback(int index, cbProbe p)
+{
+  vtkObject *o = this->Probes->GetItemAsObject(index);
+  vtkActor *a = vtkActor::SafeDownCast(o);
 
-  vtkCollectionSimpleIterator iter;
-  this->Probes->InitTraversal(iter);
+  if (!a) {
+    std::cout << "Could not find at " << index << std::endl;
+    return;
+  }
 
-  vtkActor *act = NULL;
-  while ((act = this->Probes->GetNextActor(iter))) {
-    if (act != a) { //Not the active electrode
-      act->GetMapper()->SetLookupTable(passive);
-      act->GetProperty()->SetAmbient(0.3);      // Low ambient (less flat)
-      act->GetProperty()->SetDiffuse(0.6);      // Moderate diffuse
-      act->GetProperty()->SetSpecular(0.8);     // High specular (shininess)
-      act->GetProperty()->SetSpecularPower(50); // Tight specular highlight
-      act->GetProperty()->SetMetallic(0.7);     // Metallic appearance
+  // Cache the index for later use
+  this->SelectedIndex = index;
+
+  // Only change the tube if the specification has changed, a change
+  // of position, angle or depth only needs a new user matrix
+  this->setProbeGeometry(vtkLODActor::SafeDownCast(a), p);
+
+  // Update the probe's position and orientation
+  this->buildProbeMatrix(a->GetUserMatrix(), p);
+
+  // Restyle the probes only when the selection has changed, and only
+  // restyle them all if a new probe might still look active
+  if (a != this->ActiveProbe) {
+    if (this->ActiveProbe) {
+      this->setProbeStyle(this->ActiveProbe, false);
+    } else {
+      vtkCollectionSimpleIterator iter;
+      this->Probes->InitTraversal(iter);
+
+      vtkActor *act = NULL;
+      while ((act = this->Probes->GetNextActor(iter))) {
+        this->setProbeStyle(act, false);
+      }
     }
+    this->setProbeStyle(a, true);
+    this->ActiveProbe = a;
+
+    // the previous probe joins the batch, and this one leaves it
+    this->updateProbeBatch();
   }
 
-  this->viewRect->Start();
+  this->viewRect->RequestRender();
 
   this->SetSavedState(false);
 }
@@ -1504,24 +2219,20 @@ void cbElectrodeView::DestroyProbeCallback(int index)
 
   if (!a) {
     std::cout << "Could not find at " << index << std::endl;
+    return;
   }
 
-  vtkActorCollection *planar_c = this->planar->GetRenderer()->GetActors();
-  vtkActorCollection *surface_c = this->surface->GetActors();
+  // Batched probes are not in the renderers, so only remove it if present
+  this->setProbeActorDrawn(a, false);
 
-  if (!planar_c->IsItemPresent(a)) {
-    std::cout << "Actor not found in planar!" << std::endl;
-  }
-  if (!surface_c->IsItemPresent(a)) {
-    std::cout << "Actor not found in surface!" << std::endl;
+  if (a == this->ActiveProbe) {
+    this->ActiveProbe = NULL;
   }
 
-  this->planar->GetRenderer()->RemoveActor(a);
-  this->surface->RemoveActor(a);
-
   this->Probes->RemoveItem(a);
+  this->updateProbeBatch();
 
-  this->viewRect->Start();
+  this->viewRect->RequestStart();
 
   this->SetSavedState(false);
 }
@@ -1559,25 +2270,25 @@ void cbElectrodeView::InitiatePlaceProbeCallback()
 void cbElectrodeView::EnableFrameVisualization()
 {
   this->Frame->SetVisibility(1);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::DisableFrameVisualization()
 {
   this->Frame->SetVisibility(0);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::EnableTagVisualization()
 {
   this->Tags->SetVisibility(1);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::DisableTagVisualization()
 {
   this->Tags->SetVisibility(0);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::ToggleSagittalVisualization(Qt::CheckState state)
@@ -1586,7 +2297,7 @@ void cbElectrodeView::ToggleSagittalVisualization(Qt::CheckState state)
   this->Slices[0].Stack->SetVisibility(s);
   this->Slices[0].Stack->SetPickable(s);
   this->Slices[0].Stack->SetDragable(s);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::ToggleCoronalVisualization(Qt::CheckState state)
@@ -1595,7 +2306,7 @@ void cbElectrodeView::ToggleCoronalVisualization(Qt::CheckState state)
   this->Slices[1].Stack->SetVisibility(s);
   this->Slices[1].Stack->SetPickable(s);
   this->Slices[1].Stack->SetDragable(s);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::ToggleAxialVisualization(Qt::CheckState state)
@@ -1604,7 +2315,7 @@ void cbElectrodeView::ToggleAxialVisualization(Qt::CheckState state)
   this->Slices[2].Stack->SetVisibility(s);
   this->Slices[2].Stack->SetPickable(s);
   this->Slices[2].Stack->SetDragable(s);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::ToggleProbeVisualizationMode(int s)
@@ -1635,7 +2346,8 @@ void cbElectrodeView::ToggleProbeVisualizationMode(int s)
       }
     }
   }
-  this->viewRect->Start();
+  this->updateProbeBatch();
+  this->viewRect->RequestStart();
 }
 
 void cbElectrodeView::ExportScreenshot()
@@ -1681,7 +2393,7 @@ void cbElectrodeView::ExportScreenshot()
 void cbElectrodeView::ToggleHelpAnnotations(int s)
 {
   this->helpAnnotation->SetVisibility(s);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::Open()
@@ -1810,6 +2522,14 @@ void cbElectrodeView::CreateMenu()
   QAction *minimizeAction = windowMenu->addAction(tr("Mi&nimize Window"));
   QAction *maximizeAction = windowMenu->addAction(tr("Ma&ximize Window"));
   QAction *fullscreenAction = windowMenu->addAction(tr("&Fullscreen Window"));
+  windowMenu->addSeparator();
+  this->VolumeRenderAction = windowMenu->addAction(tr("&Volume Render Brain"));
+  this->VolumeRenderAction->setCheckable(true);
+  QMenu *autoWindowMenu = windowMenu->addMenu(tr("&Auto Window/Level"));
+  for (size_t i = 0; i < sizeof(cbAutoWindowPresets)/sizeof(cbAutoWindowPresets[0]); i++) {
+    QAction *preset = autoWindowMenu->addAction(tr(cbAutoWindowPresets[i].Name));
+    preset->setData(static_cast<int>(i));
+  }
 
   openAction->setShortcuts(QKeySequence::Open);
   saveAction->setShortcuts(QKeySequence::Save);
@@ -1824,6 +2544,10 @@ void cbElectrodeView::CreateMenu()
   connect(minimizeAction, SIGNAL(triggered()), this, SLOT(showMinimized()));
   connect(maximizeAction, SIGNAL(triggered()), this, SLOT(showMaximized()));
   connect(fullscreenAction, SIGNAL(triggered()), this, SLOT(showFullScreen()));
+  connect(this->VolumeRenderAction, SIGNAL(toggled(bool)),
+          this, SLOT(SetSurfaceVolumeRendering(bool)));
+  connect(autoWindowMenu, SIGNAL(triggered(QAction*)),
+          this, SLOT(AutoWindow(QAction*)));
 }
 
 void cbElectrodeView::CreateAndBindTools()
@@ -1836,6 +2560,10 @@ void cbElectrodeView::CreateAndBindTools()
   this->rotateTool = vtkRotateCameraTool::New();
   this->rotateTool->AddObserver(vtkCommand::InteractionEvent,
                                 this, &cbElectrodeView::RotateVolumeCallback);
+  this->rotateTool->AddObserver(vtkCommand::StartInteractionEvent, this,
+    &cbElectrodeView::SurfaceInteractionCallback);
+  this->rotateTool->AddObserver(vtkCommand::EndInteractionEvent, this,
+    &cbElectrodeView::SurfaceInteractionCallback);
 
   this->pickTool = vtkFiducialPointsTool::New();
   this->pickTool->AddObserver(vtkCommand::InteractionEvent,
@@ -1920,6 +2648,13 @@ void cbElectrodeView::CreateAndConfigurePanes()
 
   this->viewRect->GetRenderWindow()->AddRenderer(this->surface);
   this->viewRect->Start();
+
+  // the slice lines follow the slices without a filter pipeline
+  this->SliceLineData = vtkSmartPointer<vtkPolyData>::New();
+  this->SliceLines = vtkSmartPointer<vtkActor>::New();
+  this->SliceLineTime = 0;
+  this->planar->GetRenderer()->AddObserver(vtkCommand::StartEvent,
+    this, &cbElectrodeView::SliceLinesCallback);
 }
 
 void cbElectrodeView::CreateFrameObjects()
@@ -1941,6 +2676,55 @@ void cbElectrodeView::CreateTagObjects()
 void cbElectrodeView::CreatePlanVisualization()
 {
   this->Probes = vtkActorCollection::New();
+  this->ActiveProbe = NULL;
+
+  static double active_table[2][4] = {
+    {256.0/256.0, 128.0/256.0, 0.0/256.0, 1.0}, //Fluorescent Orange
+    {1.0, 1.0, 1.0, 1.0}, //White
+  };
+
+  static double passive_table[2][4] = {
+    {0.75, 0.75, 0.75, 1.0},
+    {1.0, 1.0, 1.0, 1.0},
+  };
+
+  // the batch draws each passive probe as an instance of its type
+  this->ProbeInstances = vtkSmartPointer<vtkPolyData>::New();
+  this->ProbeContactBatch = vtkSmartPointer<vtkActor>::New();
+  this->ProbeInsulatorBatch = vtkSmartPointer<vtkActor>::New();
+  vtkActor *batches[2] = { this->ProbeContactBatch,
+                           this->ProbeInsulatorBatch };
+  for (vtkActor *batch : batches) {
+    vtkNew<vtkGlyph3DMapper> mapper;
+    mapper->SetInputData(this->ProbeInstances);
+    mapper->SourceIndexingOn();
+    mapper->SetSourceIndexArray("Type");
+    mapper->SetOrientationModeToQuaternion();
+    mapper->SetOrientationArray("Orientation");
+    mapper->ScalingOff();
+    mapper->SetColorModeToDirectScalars();
+    // only the contacts take their color from the instances
+    mapper->SetScalarVisibility(batch == this->ProbeContactBatch);
+    batch->SetMapper(mapper);
+  }
+
+  // the tables are shared by all probes, rather than made per update
+  this->ActiveProbeTable = vtkSmartPointer<vtkLookupTable>::New();
+  this->PassiveProbeTable = vtkSmartPointer<vtkLookupTable>::New();
+  vtkLookupTable *tables[2] = { this->ActiveProbeTable,
+                                this->PassiveProbeTable };
+  for (int j = 0; j < 2; j++) {
+    tables[j]->SetTableRange(0, 1);
+    tables[j]->SetNanColor(1.0, 0.0, 0.0, 1.0);
+    tables[j]->SetNumberOfTableValues(2);
+    tables[j]->Build();
+    for (int i = 0; i < 2; i++) {
+      tables[j]->SetTableValue(i, (j == 0 ? active_table[i] : passive_table[i]));
+    }
+  }
+
+  this->setProbeStyle(this->ProbeContactBatch, false);
+  this->setProbeStyle(this->ProbeInsulatorBatch, false);
 }
 
 void cbElectrodeView::CreateLabelsAndAnnotations()
@@ -1980,7 +2764,6 @@ void cbElectrodeView::DestroyMembers()
   this->pickTool->Delete();
 
   this->ImageProperty->Delete();
-  this->CTProperty->Delete();
 }
 
 void cbElectrodeView::ClearCurrentWorkSpace()
@@ -1992,8 +2775,17 @@ void cbElectrodeView::ClearCurrentWorkSpace()
   this->CreateFrameObjects();
   this->CreatePlanVisualization();
   this->CreateLabelsAndAnnotations();
+  this->ClearSecondaryLayers();
 
-  this->viewRect->Start();
+  this->viewRect->RequestStart();
+}
+
+void cbElectrodeView::ClearSecondaryLayers()
+{
+  this->secondaryKeys.clear();
+  this->SecondaryProperties.clear();
+
+  emit SecondaryLayersCleared();
 }
 
 void cbElectrodeView::closeEvent(QCloseEvent *e)
@@ -2084,19 +2876,20 @@ void cbElectrodeView::OpenCT()
     path = this->GetPlanFolder();
     }
 
-  cbQtDicomDirDialog dialog(NULL, "Open Secondary Series", path);
-  if (!dialog.exec()) {
-    return;
-  }
+  // collect several series, so that they can be registered together
+  QList<QStringList> series =
+    cbQtDicomDirDialog::getSeriesList(this, "Open Secondary Series", &path);
 
-  emit OpenCTData(dialog.selectedFiles());
+  if (!series.isEmpty()) {
+    emit OpenSecondaryData(series);
+  }
 }
 
 void cbElectrodeView::DisplayCTData(vtkDataManager::UniqueKey k)
 {
-  this->ctKey = k;
+  this->secondaryKeys.push_back(k);
 
-  vtkImageNode *secondary_node = this->dataManager->FindImageNode(this->ctKey);
+  vtkImageNode *secondary_node = this->dataManager->FindImageNode(k);
   vtkImageData *ct_data = secondary_node->GetImage();
   vtkMatrix4x4 *matrix = secondary_node->GetMatrix();
 
@@ -2112,8 +2905,15 @@ void cbElectrodeView::DisplayCTData(vtkDataManager::UniqueKey k)
   secondary_patient_label.append(patient_name);
   this->AppendMetaData(secondary_patient_label);
 
-  this->CTProperty->DeepCopy(this->ImageProperty);
-  this->CTProperty->SetOpacity(1.00);
+  // each secondary series is stacked on top of the previous ones
+  int layer = cbElectrodeView::kCT +
+    static_cast<int>(this->SecondaryProperties.size());
+  vtkSmartPointer<vtkImageProperty> property =
+    vtkSmartPointer<vtkImageProperty>::New();
+  property->DeepCopy(this->ImageProperty);
+  property->SetOpacity(1.00);
+  property->SetLayerNumber(layer);
+  this->SecondaryProperties.push_back(property);
 
   // Set window/level to display up to the 99th percentile of image
   // pixels (i.e. the brightest 1% of the pixels will saturate).
@@ -2122,10 +2922,10 @@ void cbElectrodeView::DisplayCTData(vtkDataManager::UniqueKey k)
   // For CT, also set the lower range at half of the full range,
   // so that the brain case is transparent.
   double range[2];
-  cbElectrodeView::ComputePercentileRange(ct_data, 99.0, range);
-  this->CTProperty->SetColorWindow(range[1] - range[0]);
-  this->CTProperty->SetColorLevel(0.5*(range[1] + range[0]));
-  this->CTProperty->SetInterpolationTypeToCubic();
+  cbElectrodeView::ComputePercentileRange(secondary_node, 99.0, range);
+  property->SetColorWindow(range[1] - range[0]);
+  property->SetColorLevel(0.5*(range[1] + range[0]));
+  property->SetInterpolationTypeToCubic();
 
   if (!ct_data || !matrix) {
     std::cout << "Error: Could not display CT data." << std::endl;
@@ -2141,7 +2941,7 @@ void cbElectrodeView::DisplayCTData(vtkDataManager::UniqueKey k)
     mapper->SetSlicePlane(this->Slices[i].WorldPlane);
 
     slice->SetMapper(mapper);
-    slice->SetProperty(this->CTProperty);
+    slice->SetProperty(property);
     slice->SetUserMatrix(this->frameTransform);
 
     vtkImageStack *stack = this->Slices[i].Stack;
@@ -2151,9 +2951,18 @@ void cbElectrodeView::DisplayCTData(vtkDataManager::UniqueKey k)
   }
 
   // Add the CT to the side panes
-  this->addDataToPanes(ct_data, this->frameTransform, this->CTProperty);
+  this->addDataToPanes(ct_data, this->frameTransform, property);
+
+  // use the series description to identify the layer
+  std::string description =
+    secondary_meta_data->GetAttributeValue(DC::SeriesDescription).AsString();
+  if (description.empty()) {
+    description =
+      "Secondary " + std::to_string(this->SecondaryProperties.size());
+  }
+  emit SecondaryLayerAdded(QString::fromStdString(description));
 
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::About()
@@ -2178,22 +2987,200 @@ THIS VERSION OF TACTICS IS NOT CERTIFIED AS A MEDICAL DEVICE FOR PRIMARY DIAGNOS
 void cbElectrodeView::SetCTOpacity(double o)
 {
   assert((o <= 1.0 && o >= 0.0) && "Opacity must be between 0.0 and 1.0");
-  this->CTProperty->SetOpacity(o);
-  this->viewRect->GetRenderWindow()->Render();
+  size_t n = this->SecondaryProperties.size();
+  for (size_t i = 0; i < n; i++) {
+    this->SecondaryProperties[i]->SetOpacity(o);
+  }
+  this->viewRect->RequestRender();
+}
+
+void cbElectrodeView::SetSecondaryOpacity(int layer, double o)
+{
+  assert((o <= 1.0 && o >= 0.0) && "Opacity must be between 0.0 and 1.0");
+  if (layer < 0 ||
+      static_cast<size_t>(layer) >= this->SecondaryProperties.size()) {
+    return;
+  }
+  this->SecondaryProperties[layer]->SetOpacity(o);
+  this->viewRect->RequestRender();
 }
 
 void cbElectrodeView::ComputePercentileRange(
-  vtkImageData *data, double percentile, double range[2])
+  vtkImageNode *node, double percentile, double range[2], bool useStencil)
+{
+  // the node keeps its histogram, so there is no pass through the image
+  // unless the image has changed since the last time
+  node->GetPercentileRange(0.0, percentile, range, useStencil);
+
+  // expand the top of the range by 10%
+  double delta = range[1] - range[0];
+  range[1] += 0.1*delta;
+}
+
+void cbElectrodeView::AutoWindow(QAction *action)
+{
+  vtkImageNode *node = this->dataManager->FindImageNode(this->dataKey);
+  if (!node) {
+    return;
+  }
+
+  int i = action->data().toInt();
+  double range[2];
+  node->GetPercentileRange(cbAutoWindowPresets[i].Lower,
+                           cbAutoWindowPresets[i].Upper, range,
+                           cbAutoWindowPresets[i].UseStencil);
+  if (range[1] <= range[0]) {
+    return;
+  }
+
+  this->ImageProperty->SetColorWindow(range[1] - range[0]);
+  this->ImageProperty->SetColorLevel(0.5*(range[1] + range[0]));
+  this->viewRect->RequestRender();
+}
+
+void cbElectrodeView::GetStencilRuns(
+  vtkImageData *data, vtkImageStencilData *stencil,
+  std::vector<int> *runs, int inside[6])
+{
+  int extent[6];
+  double origin[3], spacing[3];
+  data->GetExtent(extent);
+  data->GetOrigin(origin);
+  data->GetSpacing(spacing);
+
+  // the stencil might be on a finer grid than the data, so each data
+  // row takes the nearest stencil row, and each run is rescaled
+  int stencilExtent[6];
+  double stencilOrigin[3], stencilSpacing[3];
+  stencil->GetExtent(stencilExtent);
+  stencil->GetOrigin(stencilOrigin);
+  stencil->GetSpacing(stencilSpacing);
+
+  runs->clear();
+  for (int i = 0; i < 3; i++) {
+    inside[2*i] = VTK_INT_MAX;
+    inside[2*i + 1] = VTK_INT_MIN;
+  }
+  for (int z = extent[4]; z <= extent[5]; z++) {
+    int sz = vtkMath::Round(
+      (origin[2] + z*spacing[2] - stencilOrigin[2])/stencilSpacing[2]);
+    if (sz < stencilExtent[4] || sz > stencilExtent[5]) {
+      continue;
+    }
+    for (int y = extent[2]; y <= extent[3]; y++) {
+      int sy = vtkMath::Round(
+        (origin[1] + y*spacing[1] - stencilOrigin[1])/stencilSpacing[1]);
+      if (sy < stencilExtent[2] || sy > stencilExtent[3]) {
+        continue;
+      }
+      int iter = 0;
+      int r1, r2;
+      while (stencil->GetNextExtent(r1, r2, stencilExtent[0],
+                                    stencilExtent[1], sy, sz, iter)) {
+        double x1 = stencilOrigin[0] + (r1 - 0.5)*stencilSpacing[0];
+        double x2 = stencilOrigin[0] + (r2 + 0.5)*stencilSpacing[0];
+        int i1 = vtkMath::Ceil((x1 - origin[0])/spacing[0]);
+        int i2 = vtkMath::Floor((x2 - origin[0])/spacing[0]);
+        i1 = (i1 > extent[0] ? i1 : extent[0]);
+        i2 = (i2 < extent[1] ? i2 : extent[1]);
+        if (i1 > i2) {
+          continue;
+        }
+        runs->push_back(i1);
+        runs->push_back(i2);
+        runs->push_back(y);
+        runs->push_back(z);
+        inside[0] = (i1 < inside[0] ? i1 : inside[0]);
+        inside[1] = (i2 > inside[1] ? i2 : inside[1]);
+        inside[2] = (y < inside[2] ? y : inside[2]);
+        inside[3] = (y > inside[3] ? y : inside[3]);
+        inside[4] = (z < inside[4] ? z : inside[4]);
+        inside[5] = (z > inside[5] ? z : inside[5]);
+      }
+    }
+  }
+
+  // an empty stencil leaves the whole volume uncropped
+  if (inside[0] > inside[1]) {
+    for (int i = 0; i < 6; i++) {
+      inside[i] = extent[i];
+    }
+  }
+}
+
+void cbElectrodeView::MakeStencilMask(
+  vtkImageData *data, vtkImageStencilData *stencil,
+  vtkImageData *mask, double bounds[6])
 {
-  vtkNew<vtkImageHistogramStatistics> statistics;
+  double origin[3], spacing[3];
+  data->GetOrigin(origin);
+  data->GetSpacing(spacing);
 
-  statistics->SetInputData(data);
-  statistics->SetAutoRangePercentiles(0.0, percentile);
-  statistics->SetAutoRangeExpansionFactors(0.0, 0.1);
-  statistics->Update();
-  statistics->GetAutoRange(range);
+  std::vector<int> runs;
+  int inside[6];
+  cbElectrodeView::GetStencilRuns(data, stencil, &runs, inside);
+
+  // the mask only covers the stencil bounds, like MakeStencilVolume()
+  mask->SetExtent(inside);
+  mask->SetOrigin(origin);
+  mask->SetSpacing(spacing);
+  mask->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+
+  unsigned char *maskPtr =
+    static_cast<unsigned char *>(mask->GetScalarPointer());
+  vtkIdType rowSize = inside[1] - inside[0] + 1;
+  vtkIdType sliceSize = rowSize*(inside[3] - inside[2] + 1);
+  memset(maskPtr, 0, sliceSize*(inside[5] - inside[4] + 1));
+
+  for (size_t j = 0; j < runs.size(); j += 4) {
+    int i1 = runs[j];
+    int i2 = runs[j + 1];
+    unsigned char *rowPtr = maskPtr + (runs[j + 3] - inside[4])*sliceSize +
+                            (runs[j + 2] - inside[2])*rowSize - inside[0];
+    memset(rowPtr + i1, 255, i2 - i1 + 1);
+  }
 
-  statistics->SetInputData(0);
+  for (int i = 0; i < 3; i++) {
+    bounds[2*i] = origin[i] + inside[2*i]*spacing[i];
+    bounds[2*i + 1] = origin[i] + inside[2*i + 1]*spacing[i];
+  }
+}
+
+void cbElectrodeView::MakeStencilVolume(
+  vtkImageData *data, vtkImageStencilData *stencil,
+  vtkImageData *output, double bounds[6])
+{
+  double origin[3], spacing[3];
+  data->GetOrigin(origin);
+  data->GetSpacing(spacing);
+
+  std::vector<int> runs;
+  int inside[6];
+  cbElectrodeView::GetStencilRuns(data, stencil, &runs, inside);
+
+  // the output only covers the stencil bounds, and starts out empty
+  output->SetExtent(inside);
+  output->SetOrigin(origin);
+  output->SetSpacing(spacing);
+  output->AllocateScalars(data->GetScalarType(),
+                          data->GetNumberOfScalarComponents());
+  output->GetPointData()->GetScalars()->Fill(data->GetScalarRange()[0]);
+
+  // copy each run of voxels that is within the stencil
+  size_t voxelSize = data->GetScalarSize()*data->GetNumberOfScalarComponents();
+  for (size_t j = 0; j < runs.size(); j += 4) {
+    int i1 = runs[j];
+    int i2 = runs[j + 1];
+    int y = runs[j + 2];
+    int z = runs[j + 3];
+    memcpy(output->GetScalarPointer(i1, y, z),
+           data->GetScalarPointer(i1, y, z), (i2 - i1 + 1)*voxelSize);
+  }
+
+  for (int i = 0; i < 3; i++) {
+    bounds[2*i] = origin[i] + inside[2*i]*spacing[i];
+    bounds[2*i + 1] = origin[i] + inside[2*i + 1]*spacing[i];
+  }
 }
 
 void cbElectrodeView::SnapViewVectorsToVolume(vtkMatrix4x4 *matrix,
@@ -2284,5 +3271,5 @@ void cbElectrodeView::SetClippingRange(vtkCamera *c)
 void cbElectrodeView::TogglePatientAnnotations(int s)
 {
   this->MetaAnnotation->SetVisibility(s);
-  this->viewRect->GetRenderWindow()->Render();
+  this->viewRect->RequestRender();
 }
@@ -54,8 +54,11 @@
 #include <QString>
 #include <QStringList>
 
+#include <map>
 #include <vector>
 
+class QTimer;
+
 class vtkActor;
 class vtkActorCollection;
 class vtkCamera;
@@ -64,8 +67,13 @@ class vtkDynamicViewFrame;
 class vtkFiducialPointsTool;
 class vtkFollower;
 class vtkImageData;
+class vtkImageNode;
 class vtkImageSlice;
+class vtkImageStencilData;
 class vtkImageViewPane;
+class vtkLODActor;
+class vtkLODProp3D;
+class vtkLookupTable;
 class vtkMatrix4x4;
 class vtkPlaneCollection;
 class vtkPolyData;
@@ -73,6 +81,9 @@ class vtkPushPlaneTool;
 class vtkRenderer;
 class vtkRotateCameraTool;
 class vtkSliceImageTool;
+class vtkVolume;
+class vtkVolumeMapper;
+class vtkVolumeProperty;
 
 class cbElectrodeView : public cbMainWindow
 {
@@ -98,9 +109,12 @@ public:
   };
 
 public slots:
-  //! Incoming signal to set the CT layer opacity.
+  //! Incoming signal to set the opacity of all secondary layers.
   void SetCTOpacity(double o);
 
+  //! Incoming signal to set the opacity of one secondary layer.
+  void SetSecondaryOpacity(int layer, double o);
+
   //! Incoming signal to display the secondary series.
   void DisplayCTData(vtkDataManager::UniqueKey k);
 
@@ -123,8 +137,18 @@ public slots:
   void displayTags(vtkDataManager::UniqueKey);
 
   //! Incoming signal to display the surface rendering.
+  /*!
+   *  The volume is only built if volume rendering of the brain has
+   *  been requested, otherwise the brain mesh is shown instead.
+  */
   void displaySurfaceVolume(vtkDataManager::UniqueKey);
 
+  //! Incoming signal to display the brain mesh in the surface pane.
+  void displayBrainSurface(vtkDataManager::UniqueKey);
+
+  //! Choose between volume rendering and the brain mesh.
+  void SetSurfaceVolumeRendering(bool on);
+
   //! Set the Left/Right labels in the 2D panes
   void PositionLRLabelsIn2DPanes();
 
@@ -163,6 +187,13 @@ public slots:
   //! Incoming signal to save a screenshot of the render window.
   void ExportScreenshot();
 
+  //! Incoming signal to render on the next frame.
+  /*!
+   *  FrameStarting() is emitted just before the render, so that the
+   *  sender can apply any edits that it has held back.
+  */
+  void RequestFrame();
+
 private slots:
   //! Action to perform when the 'Open' file menu option is activated.
   void Open();
@@ -179,9 +210,21 @@ private slots:
   //! Action to perform when the 'About' option is activated.
   void About();
 
+  //! Render the surface pane at full quality once rotation pauses.
+  void SurfaceIdle();
+
+  //! Set the window/level of the primary image from a preset.
+  void AutoWindow(QAction *action);
+
 signals:
-  //! Outgoing signal requesting controller to open CT data.
-  void OpenCTData(const QStringList& files);
+  //! Outgoing signal requesting controller to open secondary series.
+  void OpenSecondaryData(const QList<QStringList>& series);
+
+  //! Outgoing signal to announce a new secondary layer.
+  void SecondaryLayerAdded(const QString& name);
+
+  //! Outgoing signal to announce that all secondary layers were removed.
+  void SecondaryLayersCleared();
 
   //! Outgoing signal to create a new probe.
   void CreateProbeRequest(double x, double y, double z,
@@ -192,6 +235,12 @@ signals:
   void SavePlan(const QString& file);
   void OpenPlan(const QString& file);
 
+  //! Outgoing signal that the surface pane needs the brain volume.
+  void SurfaceVolumeRequested();
+
+  //! Outgoing signal that a requested render is about to be done.
+  void FrameStarting();
+
 private:
   //! Caching for previous and current tool.
   cursortool lastTool;
@@ -246,7 +295,7 @@ private:
 
   //! The key to use to grab the image data from the manager.
   vtkDataManager::UniqueKey dataKey;
-  vtkDataManager::UniqueKey ctKey;
+  std::vector<vtkDataManager::UniqueKey> secondaryKeys;
 
   //! File path to the save file.
   QString SaveFile;
@@ -266,6 +315,110 @@ private:
   void MinimizeSurfaceRenderer();
   void MaximizeSurfaceRenderer();
 
+  //! Choose the surface volume resolution for the current pane size.
+  /*!
+   *  The voxels are made no smaller than a pixel of the surface pane,
+   *  and the number of voxels is kept within SurfaceVolumeVoxelLimit.
+   *  If allowCoarser is false, the volume is only ever made finer.
+  */
+  void updateSurfaceVolumeResolution(bool allowCoarser);
+
+  //! Build the surface volume from the image and brain stencil.
+  void createSurfaceVolume();
+
+  //! Check whether the surface volume should be ray cast on the CPU.
+  /*!
+   *  This is true when the GPU mapper is not supported or OpenGL is
+   *  implemented in software, unless the "surfaceVolumeRayCast" setting
+   *  is "gpu" or "cpu" to force the choice.
+  */
+  bool UseCPUVolumeRayCast(vtkVolumeProperty *property);
+
+  //! Reduce the surface pane detail while the camera is rotating.
+  void SurfaceInteractionCallback(vtkObject *, unsigned long, void *);
+
+  //! Rebuild the slice lines before the planar pane renders, if needed.
+  void SliceLinesCallback(vtkObject *, unsigned long, void *);
+
+  //! Compute the slice borders and the slice intersections.
+  /*!
+   *  The border of each slice is where its plane cuts the image bounds,
+   *  and each pair of slices meets along a line that is clipped to the
+   *  bounds.  These are found directly from the plane equations, in
+   *  data coordinates, and are stored as lines in SliceLineData.
+  */
+  void buildSliceLines();
+
+  //! The slice borders and intersections, colored per line.
+  vtkSmartPointer<vtkPolyData> SliceLineData;
+  vtkSmartPointer<vtkActor> SliceLines;
+
+  //! The image bounds, slightly expanded, that contain the slice lines.
+  double SliceLineBounds[6];
+
+  //! The latest plane or matrix modification that the lines include.
+  vtkMTimeType SliceLineTime;
+
+  //! Switch the surface pane between interactive and full quality.
+  void setSurfaceInteractive(bool interactive);
+
+  //! Choose the interactive image sample distance from the frame time.
+  /*!
+   *  The last render time of the surface pane is compared with
+   *  SurfaceFrameTimeTarget, and the distance is kept within [1,4].
+  */
+  void adaptSurfaceDetail();
+
+  //! Set the sample distances of the surface volume mapper.
+  void applySurfaceDetail();
+
+  //! The target render time for the surface pane while rotating.
+  double SurfaceFrameTimeTarget;
+  //! The image sample distance used while rotating.
+  double SurfaceImageSampleDistance;
+  bool SurfaceInteractive;
+  QTimer *SurfaceIdleTimer;
+
+  //! Reduce the slice quality while a tool cursor drag is active.
+  void SliceInteractionCallback(vtkObject *, unsigned long, void *);
+
+  //! Announce a requested render, before it is done.
+  void PendingRenderCallback(vtkObject *, unsigned long, void *);
+
+  //! Switch the image slices between interactive and full quality.
+  /*!
+   *  While interactive, the slices use SliceInteractiveInterpolation
+   *  instead of cubic interpolation, and if SliceInteractiveResample
+   *  is off, the planar slices are resampled at the image resolution
+   *  rather than at the screen resolution.
+  */
+  void setSliceInteractive(bool interactive);
+
+  //! The interpolation type (nearest or linear) used while dragging.
+  int SliceInteractiveInterpolation;
+  //! Whether to resample the planar slices to the screen while dragging.
+  bool SliceInteractiveResample;
+  bool SliceInteractive;
+
+  //! The brain mesh, decimated into levels of detail.
+  vtkSmartPointer<vtkLODProp3D> BrainSurface;
+  int BrainSurfaceFullLOD;
+
+  //! Use volume rendering rather than the mesh for the surface pane.
+  bool VolumeRenderSurface;
+  QAction *VolumeRenderAction;
+
+  //! The surface volume, and the key for its image and brain stencil.
+  vtkSmartPointer<vtkVolume> SurfaceVolume;
+  vtkSmartPointer<vtkVolumeMapper> SurfaceMapper;
+  vtkDataManager::UniqueKey surfaceVolumeKey;
+
+  //! The voxel size the surface volume is rendered at, in millimetres.
+  double SurfaceVolumeSpacing;
+
+  //! The maximum number of voxels in the surface volume.
+  double SurfaceVolumeVoxelLimit;
+
   //! Set whether or not the application has been saved.
   void SetSavedState(bool s);
 
@@ -283,8 +436,6 @@ private:
     virtual ~Slice();
 
     vtkSmartPointer<vtkImageStack> Stack;
-    vtkSmartPointer<vtkActor> Border;
-    vtkSmartPointer<vtkActor> Intersect;
     vtkSmartPointer<vtkPlane> WorldPlane;
     vtkSmartPointer<vtkFollowerPlane> DataPlane;
     double Orientation[3];
@@ -295,11 +446,30 @@ private:
 
   //! The image property to use for layering.
   vtkImageProperty *ImageProperty;
-  vtkImageProperty *CTProperty;
+
+  //! One property per secondary layer, the layer number is kCT + index.
+  std::vector<vtkSmartPointer<vtkImageProperty> > SecondaryProperties;
 
   //! Collection of probe actors for rendering.
   vtkActorCollection *Probes;
 
+  //! The probe that is styled as active, or NULL if none is.
+  vtkActor *ActiveProbe;
+
+  //! Lookup tables shared by all probes, for the active and passive styles.
+  vtkSmartPointer<vtkLookupTable> ActiveProbeTable;
+  vtkSmartPointer<vtkLookupTable> PassiveProbeTable;
+
+  //! Number of probes at which the passive probes are drawn as a batch.
+  int ProbeBatchThreshold;
+
+  //! One point per batched probe, with its orientation, type and color.
+  vtkSmartPointer<vtkPolyData> ProbeInstances;
+
+  //! Actors that draw the contacts and insulators of the batched probes.
+  vtkSmartPointer<vtkActor> ProbeContactBatch;
+  vtkSmartPointer<vtkActor> ProbeInsulatorBatch;
+
   //! Cache of the latest probe selection index.
   int SelectedIndex;
 
@@ -312,7 +482,51 @@ private:
   void AddLayer(vtkImageProperty *p);
 
   //! Builds the basic probe polydata into the argument object.
-  void buildProbeMarker(vtkPolyData *probeData, cbProbe p);
+  /*!
+   *  If band is 0 or 1, only the contacts or the insulators are built.
+   */
+  void buildProbeMarker(vtkPolyData *probeData, cbProbe p, int sides = 26,
+                        int band = -1);
+
+  //! Probe polydata for one catalogue number, shared by all its probes.
+  struct ProbeGeometry
+  {
+    //! The full tube, and a tube with fewer sides for fast renders.
+    vtkSmartPointer<vtkPolyData> Full;
+    vtkSmartPointer<vtkPolyData> Coarse;
+
+    //! The contacts and the insulators alone, for instanced drawing.
+    vtkSmartPointer<vtkPolyData> Contacts;
+    vtkSmartPointer<vtkPolyData> Insulators;
+  };
+
+  //! Cache of the probe polydata, keyed by catalogue number.
+  std::map<std::string, ProbeGeometry> ProbeGeometryCache;
+
+  //! Gets the cached polydata for the probe, building it if necessary.
+  const ProbeGeometry &probeGeometry(cbProbe p);
+
+  //! Sets the probe's mappers to the polydata for its specification.
+  void setProbeGeometry(vtkLODActor *actor, cbProbe p);
+
+  //! Builds the matrix that places the probe at its position and angles.
+  void buildProbeMatrix(vtkMatrix4x4 *matrix, cbProbe p);
+
+  //! Styles the probe as the active (selected) or a passive probe.
+  void setProbeStyle(vtkActor *actor, bool active);
+
+  //! Adds the actor to, or removes it from, the planar and surface panes.
+  void setProbeActorDrawn(vtkActor *actor, bool drawn);
+
+  //! Moves the passive probes into the batch, or out of it.
+  /*!
+   *  When there are at least ProbeBatchThreshold probes, every visible
+   *  probe except the active one is drawn by two vtkGlyph3DMappers,
+   *  with one instance per probe and one source per probe type.  The
+   *  active probe keeps its own actor, so editing it does not change
+   *  the batch.
+   */
+  void updateProbeBatch();
 
   //! Adds a string to a renderer annotation in a specified corner.
   void addRendererLabel(vtkRenderer *r, const char *str, int corner);
@@ -324,9 +538,47 @@ private:
   void createPlanarView(vtkImageData *data, vtkMatrix4x4 *matrix,
                         vtkImageProperty *property);
 
-  //! Compute an appropriate window/level range for a data set.
-  static void ComputePercentileRange(vtkImageData *data, double percentile,
-                                     double range[2]);
+  //! Compute an appropriate window/level range for an image node.
+  /*!
+   *  The range comes from the histogram that is cached by the node.
+   *  If useStencil is set, only the voxels within the node's stencil
+   *  are used.
+  */
+  static void ComputePercentileRange(vtkImageNode *node, double percentile,
+                                     double range[2],
+                                     bool useStencil = false);
+
+  //! Make a binary mask for volume rendering from a stencil.
+  /*!
+   *  The mask extent is cropped to the bounds of the stencil, which
+   *  are also returned.  The volume mapper requires the mask to have
+   *  the same extent as its input, so the input must be made with
+   *  MakeStencilVolume().
+  */
+  static void MakeStencilMask(vtkImageData *data,
+                              vtkImageStencilData *stencil,
+                              vtkImageData *mask, double bounds[6]);
+
+  //! Copy the part of an image that is within a stencil.
+  /*!
+   *  The output extent is cropped to the bounds of the stencil, which
+   *  are also returned, and voxels outside of the stencil are set to
+   *  the minimum value of the data.  This is for volume mappers that
+   *  have no mask input.
+  */
+  static void MakeStencilVolume(vtkImageData *data,
+                                vtkImageStencilData *stencil,
+                                vtkImageData *output, double bounds[6]);
+
+  //! Get the runs of data voxels that are within a stencil.
+  /*!
+   *  Each run is stored as four values: x1, x2, y, z.  The extent of
+   *  the runs is returned in "inside", or the data extent if there
+   *  are no runs.
+  */
+  static void GetStencilRuns(vtkImageData *data,
+                             vtkImageStencilData *stencil,
+                             std::vector<int> *runs, int inside[6]);
 
   //! Snap two view vectors to the closest image volume axes.
   /* The matrix that is provided must be the matrix that goes from
@@ -345,6 +597,9 @@ private:
   //! Destroys all member variables.
   void DestroyMembers();
 
+  //! Forget the secondary series, e.g. when a new primary is opened.
+  void ClearSecondaryLayers();
+
   //! Create the file menus and connect actions.
   void CreateMenu();
 
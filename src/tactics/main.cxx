@@ -111,6 +111,12 @@ int main(int argc, char *argv[])
                    &window, SLOT(initializeProgress(int, int)));
   QObject::connect(&controller, SIGNAL(displayProgress(int)),
                    &window, SLOT(displayProgress(int)));
+  QObject::connect(&controller, SIGNAL(enableCancel(bool)),
+                   &window, SLOT(enableCancel(bool)));
+  QObject::connect(&controller, SIGNAL(enableInterface(bool)),
+                   &window, SLOT(enableInterface(bool)));
+  QObject::connect(&window, SIGNAL(cancelRequested()),
+                   &controller, SLOT(cancel()));
 
   QObject::connect(&controller,
                    SIGNAL(displayLeksellFrame(vtkMatrix4x4 *)),
@@ -136,9 +142,15 @@ int main(int argc, char *argv[])
                    SIGNAL(displaySurfaceVolume(vtkDataManager::UniqueKey)),
                    &window,
                    SLOT(displaySurfaceVolume(vtkDataManager::UniqueKey)));
+  QObject::connect(&controller,
+                   SIGNAL(displayBrainSurface(vtkDataManager::UniqueKey)),
+                   &window,
+                   SLOT(displayBrainSurface(vtkDataManager::UniqueKey)));
+  QObject::connect(&window, SIGNAL(SurfaceVolumeRequested()),
+                   &controller, SLOT(requestSurfaceVolume()));
 
-  QObject::connect(&window, SIGNAL(OpenCTData(const QStringList&)),
-                   &controller, SLOT(OpenCTData(const QStringList&)));
+  QObject::connect(&window, SIGNAL(OpenSecondaryData(const QList<QStringList>&)),
+                   &controller, SLOT(OpenSecondaryData(const QList<QStringList>&)));
   QObject::connect(&controller, SIGNAL(DisplayCTData(vtkDataManager::UniqueKey)),
                    &window, SLOT(DisplayCTData(vtkDataManager::UniqueKey)));
 
@@ -147,8 +159,10 @@ int main(int argc, char *argv[])
                    &controller, SLOT(requestOpenImage(const QStringList&)));
   QObject::connect(&openStage, SIGNAL(registerAntPost(int)),
                    &controller, SLOT(registerAntPost(int)));
-  QObject::connect(&openStage, SIGNAL(requestOpenCT(const QStringList&)),
-                   &controller, SLOT(OpenCTData(const QStringList&)));
+  QObject::connect(&openStage, SIGNAL(recomputeFrame(int)),
+                   &controller, SLOT(setRecomputeFrame(int)));
+  QObject::connect(&openStage, SIGNAL(requestOpenSecondary(const QList<QStringList>&)),
+                   &controller, SLOT(OpenSecondaryData(const QList<QStringList>&)));
   QObject::connect(&controller, SIGNAL(displayData(vtkDataManager::UniqueKey)),
                    &window, SLOT(displayData(vtkDataManager::UniqueKey)));
 
@@ -170,6 +184,12 @@ int main(int argc, char *argv[])
 
   QObject::connect(&planStage, SIGNAL(SetCTOpacity(double)),
                    &window, SLOT(SetCTOpacity(double)));
+  QObject::connect(&planStage, SIGNAL(SetSecondaryOpacity(int, double)),
+                   &window, SLOT(SetSecondaryOpacity(int, double)));
+  QObject::connect(&window, SIGNAL(SecondaryLayerAdded(const QString&)),
+                   &planStage, SLOT(AddSecondaryLayer(const QString&)));
+  QObject::connect(&window, SIGNAL(SecondaryLayersCleared()),
+                   &planStage, SLOT(ClearSecondaryLayers()));
 
   qRegisterMetaType<cbProbe>("cbProbe");
   QObject::connect(&planStage, SIGNAL(InitiatePlaceProbeCallback()),
@@ -180,6 +200,10 @@ int main(int argc, char *argv[])
                    &window, SLOT(DestroyProbeCallback(int)));
   QObject::connect(&planStage, SIGNAL(UpdateProbeCallback(int, cbProbe)),
                    &window, SLOT(UpdateProbeCallback(int, cbProbe)));
+  QObject::connect(&planStage, SIGNAL(ProbeUpdatePending()),
+                   &window, SLOT(RequestFrame()));
+  QObject::connect(&window, SIGNAL(FrameStarting()),
+                   &planStage, SLOT(applyPendingProbeUpdate()));
   QObject::connect(&planStage, SIGNAL(EnableFrameVisualization()),
                    &window, SLOT(EnableFrameVisualization()));
   QObject::connect(&planStage, SIGNAL(DisableFrameVisualization()),
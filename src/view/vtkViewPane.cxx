@@ -50,7 +50,11 @@
 #include "vtkProperty2D.h"
 
 #include "vtkSmartPointer.h"
+#include "vtkCamera.h"
+#include "vtkLight.h"
+#include "vtkLightCollection.h"
 #include "vtkProp.h"
+#include "vtkPropCollection.h"
 #include "vtkViewPane.h"
 #include "vtkRenderer.h"
 
@@ -90,6 +94,10 @@ vtkViewPane::vtkViewPane()
   // Set cursor tracking unavailable as default
   this->CursorTracking = false;
   this->BorderEnabled = false;
+
+  // Panes are dirty until they are first rendered
+  this->Dirty = true;
+  this->RenderedMTime = 0;
 }
 
 vtkViewPane::~vtkViewPane()
@@ -192,3 +200,61 @@ void vtkViewPane::AddBorder()
   actor->SetVisibility(1);
   this->Renderer->AddViewProp(actor);
 }
+
+bool vtkViewPane::GetDirty()
+{
+  return (this->Dirty ||
+          vtkViewPane::GetRendererMTime(this->Renderer) > this->RenderedMTime);
+}
+
+void vtkViewPane::MarkRendered()
+{
+  // Rendering itself modifies the camera (e.g. the clipping range), so
+  // the MTime is taken after the render rather than before it
+  this->Dirty = false;
+  this->RenderedMTime = vtkViewPane::GetRendererMTime(this->Renderer);
+}
+
+vtkMTimeType vtkViewPane::GetRendererMTime(vtkRenderer *renderer)
+{
+  vtkMTimeType mtime = renderer->GetMTime();
+
+  vtkCamera *camera = renderer->GetActiveCamera();
+  if (camera->GetMTime() > mtime)
+    {
+    mtime = camera->GetMTime();
+    }
+
+  vtkLightCollection *lights = renderer->GetLights();
+  if (lights->GetMTime() > mtime)
+    {
+    mtime = lights->GetMTime();
+    }
+  vtkCollectionSimpleIterator lit;
+  lights->InitTraversal(lit);
+  while (vtkLight *light = lights->GetNextLight(lit))
+    {
+    if (light->GetMTime() > mtime)
+      {
+      mtime = light->GetMTime();
+      }
+    }
+
+  vtkPropCollection *props = renderer->GetViewProps();
+  if (props->GetMTime() > mtime)
+    {
+    mtime = props->GetMTime();
+    }
+  vtkCollectionSimpleIterator pit;
+  props->InitTraversal(pit);
+  while (vtkProp *prop = props->GetNextProp(pit))
+    {
+    vtkMTimeType propTime = prop->GetRedrawMTime();
+    if (propTime > mtime)
+      {
+      mtime = propTime;
+      }
+    }
+
+  return mtime;
+}
@@ -80,6 +80,27 @@ class vtkViewPane : public vtkViewObject
 
   void AddBorder();
 
+  //! Force the pane to be redrawn at the next render.
+  /*!
+   *  This is only needed for changes that are not seen by the MTimes
+   *  of the renderer, its camera, its lights and its props.
+  */
+  void SetDirty(bool dirty) { this->Dirty = dirty; }
+
+  //! Check whether the pane has changed since it was last rendered.
+  bool GetDirty();
+
+  //! Record that the pane has just been rendered.
+  void MarkRendered();
+
+  //! Get the latest MTime of everything that a renderer displays.
+  /*!
+   *  This covers the renderer itself (e.g. its viewport and background),
+   *  its active camera, its lights, its list of props, and the props
+   *  along with their mappers, properties and input data.
+  */
+  static vtkMTimeType GetRendererMTime(vtkRenderer *renderer);
+
  protected:
   vtkViewPane();
   ~vtkViewPane();
@@ -95,6 +116,12 @@ class vtkViewPane : public vtkViewObject
 
   bool BorderEnabled;
 
+  //! Set when the pane must be redrawn regardless of MTimes.
+  bool Dirty;
+
+  //! The renderer MTime after the last render, or zero if never rendered.
+  vtkMTimeType RenderedMTime;
+
  private:
   vtkViewPane(const vtkViewPane&); // Not implemented.
   void operator=(const vtkViewPane&); // Not implemented.
@@ -46,6 +46,7 @@
 #include "vtkRenderWindow.h"
 #include "vtkRenderWindowInteractor.h"
 #include "vtkRenderer.h"
+#include "vtkRendererCollection.h"
 #include "vtkViewFrame.h"
 #include "vtkViewObjectCollection.h"
 #include "vtkViewPane.h"
@@ -68,6 +69,20 @@ vtkViewRect::vtkViewRect()
 
   this->Tracked = false;
 
+  this->PartialRendering = true;
+  this->RenderedSize[0] = 0;
+  this->RenderedSize[1] = 0;
+  this->AllDirty = true;
+  this->RenderPending = false;
+  this->StartPending = false;
+  this->RenderRequestCount = 0;
+  this->RenderCount = 0;
+  this->SuppressedRenderCount = 0;
+  this->RenderWindow->AddObserver(
+    vtkCommand::StartEvent, this, &vtkViewRect::StartRenderCallback);
+  this->RenderWindow->AddObserver(
+    vtkCommand::EndEvent, this, &vtkViewRect::EndRenderCallback);
+
   vtkRenderer *blank = vtkRenderer::New();
   this->RenderWindow->AddRenderer(blank);
   blank->Delete();
@@ -149,6 +164,274 @@ void vtkViewRect::Render()
   this->RenderWindow->Render();
 }
 
+void vtkViewRect::RequestRender()
+{
+  this->RenderRequestCount++;
+  if (this->RenderPending)
+    {
+    return;
+    }
+
+  this->RenderPending = true;
+  if (this->HasObserver(vtkViewRect::RenderRequestedEvent))
+    {
+    this->InvokeEvent(vtkViewRect::RenderRequestedEvent);
+    }
+  else
+    {
+    this->ProcessPendingRender();
+    }
+}
+
+void vtkViewRect::RequestStart()
+{
+  this->StartPending = true;
+  this->RequestRender();
+}
+
+void vtkViewRect::ProcessPendingRender()
+{
+  if (!this->RenderPending)
+    {
+    return;
+    }
+
+  this->InvokeEvent(vtkViewRect::PendingRenderEvent);
+
+  bool start = this->StartPending;
+  this->RenderPending = false;
+  this->StartPending = false;
+
+  if (start)
+    {
+    this->Start();
+    }
+  else if (this->PartialRendering && !this->IsRenderNeeded())
+    {
+    this->SuppressedRenderCount++;
+    }
+  else
+    {
+    this->Render();
+    }
+}
+
+bool vtkViewRect::IsRenderNeeded()
+{
+  std::vector<vtkRenderer *> renderers;
+  std::vector<bool> dirty;
+  this->ComputeDirtyRenderers(&renderers, &dirty);
+
+  for (size_t i = 0; i < dirty.size(); i++)
+    {
+    if (dirty[i])
+      {
+      return true;
+      }
+    }
+
+  return false;
+}
+
+void vtkViewRect::ResetRenderCounts()
+{
+  this->RenderRequestCount = 0;
+  this->RenderCount = 0;
+  this->SuppressedRenderCount = 0;
+}
+
+void vtkViewRect::SetAllDirty()
+{
+  this->AllDirty = true;
+}
+
+namespace {
+
+// Check whether two viewports share any pixels
+bool ViewportsOverlap(const double a[4], const double b[4])
+{
+  return (a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3]);
+}
+
+} // end anonymous namespace
+
+void vtkViewRect::ComputeDirtyRenderers(
+  std::vector<vtkRenderer *> *rendererList, std::vector<bool> *dirtyList)
+{
+  std::vector<vtkRenderer *>& renderers = *rendererList;
+  std::vector<bool>& dirty = *dirtyList;
+
+  // Get the renderers in the order that they are drawn
+  renderers.clear();
+  vtkRendererCollection *collection = this->RenderWindow->GetRenderers();
+  int numLayers = this->RenderWindow->GetNumberOfLayers();
+  for (int layer = 0; layer < numLayers; layer++)
+    {
+    vtkCollectionSimpleIterator rit;
+    collection->InitTraversal(rit);
+    while (vtkRenderer *ren = collection->GetNextRenderer(rit))
+      {
+      if (ren->GetLayer() == layer)
+        {
+        renderers.push_back(ren);
+        }
+      }
+    }
+
+  int *size = this->RenderWindow->GetSize();
+  bool allDirty = (!this->PartialRendering || this->AllDirty ||
+                   size[0] != this->RenderedSize[0] ||
+                   size[1] != this->RenderedSize[1]);
+
+  std::map<vtkRenderer *, vtkViewPane *> panes =
+    this->RequestPanesByRenderer();
+
+  dirty.assign(renderers.size(), allDirty);
+  for (size_t i = 0; i < renderers.size() && !allDirty; i++)
+    {
+    vtkRenderer *ren = renderers[i];
+    vtkViewPane *pane = panes[ren];
+    if (pane)
+      {
+      dirty[i] = pane->GetDirty();
+      }
+    else
+      {
+      std::map<vtkRenderer *, vtkMTimeType>::iterator iter =
+        this->RenderedMTimes.find(ren);
+      dirty[i] = (iter == this->RenderedMTimes.end() ||
+                  vtkViewPane::GetRendererMTime(ren) > iter->second);
+      }
+    }
+
+  // A renderer drawn after an overlapping dirty renderer would lose its
+  // pixels to the erase, and one drawn before an overlapping dirty
+  // renderer that does not erase would show through with stale pixels
+  bool changed = !allDirty;
+  while (changed)
+    {
+    changed = false;
+    for (size_t i = 0; i < renderers.size(); i++)
+      {
+      if (!dirty[i])
+        {
+        continue;
+        }
+      double vi[4];
+      renderers[i]->GetViewport(vi);
+      for (size_t j = 0; j < renderers.size(); j++)
+        {
+        if (dirty[j] || (j < i && renderers[i]->GetErase()))
+          {
+          continue;
+          }
+        double vj[4];
+        renderers[j]->GetViewport(vj);
+        if (ViewportsOverlap(vi, vj))
+          {
+          dirty[j] = true;
+          changed = true;
+          }
+        }
+      }
+    }
+}
+
+void vtkViewRect::StartRenderCallback(vtkObject *, unsigned long, void *)
+{
+  std::vector<vtkRenderer *> renderers;
+  std::vector<bool> dirty;
+  this->ComputeDirtyRenderers(&renderers, &dirty);
+
+  for (size_t i = 0; i < renderers.size(); i++)
+    {
+    renderers[i]->SetDraw(dirty[i]);
+    }
+}
+
+void vtkViewRect::EndRenderCallback(vtkObject *, unsigned long, void *)
+{
+  std::map<vtkRenderer *, vtkViewPane *> panes =
+    this->RequestPanesByRenderer();
+
+  std::map<vtkRenderer *, vtkMTimeType> renderedMTimes;
+  vtkRendererCollection *collection = this->RenderWindow->GetRenderers();
+  vtkCollectionSimpleIterator rit;
+  collection->InitTraversal(rit);
+  while (vtkRenderer *ren = collection->GetNextRenderer(rit))
+    {
+    // Renderers that were skipped keep their previous times
+    if (ren->GetDraw())
+      {
+      vtkViewPane *pane = panes[ren];
+      if (pane)
+        {
+        pane->MarkRendered();
+        }
+      else
+        {
+        renderedMTimes[ren] = vtkViewPane::GetRendererMTime(ren);
+        }
+      }
+    else
+      {
+      std::map<vtkRenderer *, vtkMTimeType>::iterator iter =
+        this->RenderedMTimes.find(ren);
+      if (iter != this->RenderedMTimes.end())
+        {
+        renderedMTimes[ren] = iter->second;
+        }
+      ren->DrawOn();
+      }
+    }
+
+  // This also forgets renderers that were removed from the window
+  this->RenderedMTimes.swap(renderedMTimes);
+
+  int *size = this->RenderWindow->GetSize();
+  this->RenderedSize[0] = size[0];
+  this->RenderedSize[1] = size[1];
+  this->AllDirty = false;
+  this->RenderCount++;
+}
+
+std::map<vtkRenderer *, vtkViewPane *> vtkViewRect::RequestPanesByRenderer()
+{
+  std::map<vtkRenderer *, vtkViewPane *> panes;
+
+  std::queue<vtkViewObject *> queue;
+  if (this->Frame)
+    {
+    queue.push(this->Frame);
+    }
+
+  while (!queue.empty())
+    {
+    vtkViewObject *obj = queue.front();
+    queue.pop();
+
+    vtkViewPane *pane = vtkViewPane::SafeDownCast(obj);
+    vtkDynamicViewFrame *frame = vtkDynamicViewFrame::SafeDownCast(obj);
+    if (pane)
+      {
+      panes[pane->GetRenderer()] = pane;
+      }
+    else if (frame)
+      {
+      vtkViewObjectCollection *children = frame->GetChildren();
+      int currentChildren = children->GetNumberOfItems();
+
+      for (int i = 0; i < currentChildren; i++)
+        {
+        vtkViewObject *child = children->GetViewObject(i);
+        queue.push(child);
+        }
+      }
+    }
+
+  return panes;
+}
+
 vtkToolCursor *vtkViewRect::RequestToolCursor(int x, int y)
 {
   int *size = this->RenderWindow->GetSize();
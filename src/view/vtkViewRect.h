@@ -38,6 +38,8 @@
 #define VTKVIEWRECT_H
 
 #include "vtkViewObject.h"
+#include "vtkCommand.h"
+#include <map>
 #include <vector>
 
 class vtkCamera;
@@ -46,6 +48,7 @@ class vtkRenderWindow;
 class vtkRenderWindowInteractor;
 class vtkRenderer;
 class vtkDynamicViewFrame;
+class vtkViewPane;
 
 //! Container for other VTK view objects.
 /*!
@@ -62,6 +65,21 @@ class vtkViewRect : public vtkViewObject
   //! Standard VTK macro to allow for traversals of VTK class hierarchies.
   vtkTypeMacro(vtkViewRect, vtkViewObject);
 
+  //! Event invoked when a render is requested and none is pending.
+  enum { RenderRequestedEvent = vtkCommand::UserEvent + 1 };
+
+  //! Event invoked just before a requested render is done.
+  /*!
+   *  Observers can use this to apply input that has been held back
+   *  since the request, such as the latest of several mouse moves.
+   */
+  enum { PendingRenderEvent = vtkCommand::UserEvent + 2 };
+
+  // The vtkCommand::StartInteractionEvent and EndInteractionEvent are
+  // invoked on the vtkViewRect when a mouse button takes the focus for
+  // a tool cursor, and when the button is released.  Observers can use
+  // them to trade quality for speed for the duration of the drag.
+
   //! Sets the main vtkViewFrame for the layout.
   /*!
    *  \param frame The frame to use as parent to all other frames.
@@ -78,6 +96,48 @@ class vtkViewRect : public vtkViewObject
   //! Forces a render on the internal vtkRenderWindow.
   void Render();
 
+  //! Ask for a render, to be done by ProcessPendingRender().
+  /*!
+   *  Any number of requests before the next ProcessPendingRender() are
+   *  combined into one render.  The first request invokes a
+   *  RenderRequestedEvent, so that the window system can schedule the
+   *  render for the next display refresh.  If nothing observes this
+   *  event, the render is done immediately.
+  */
+  void RequestRender();
+
+  //! Ask for the renderers to be updated before the requested render.
+  /*!
+   *  This is the deferred version of Start().
+  */
+  void RequestStart();
+
+  //! Do the requested render, if any.
+  /*!
+   *  The render is skipped if partial rendering is on and nothing has
+   *  changed since the last render.
+  */
+  void ProcessPendingRender();
+
+  //! Check whether a requested render has not yet been done.
+  bool GetRenderPending() { return this->RenderPending; }
+
+  //! Check whether any renderer has changed since the last render.
+  bool IsRenderNeeded();
+
+  //! Counters for render requests, renders done, and renders skipped.
+  /*!
+   *  The number of executed renders includes every render of the render
+   *  window, including those that were not requested.  Requests that
+   *  were combined with an earlier request are neither executed nor
+   *  suppressed.
+  */
+  unsigned long GetRenderRequestCount() { return this->RenderRequestCount; }
+  unsigned long GetRenderCount() { return this->RenderCount; }
+  unsigned long GetSuppressedRenderCount() {
+    return this->SuppressedRenderCount; }
+  void ResetRenderCounts();
+
   //! Simple getter method for retrieving the internal vtkRenderWindow.
   vtkRenderWindow *GetRenderWindow() { return this->RenderWindow; }
 
@@ -111,6 +171,20 @@ class vtkViewRect : public vtkViewObject
   void SetCursorTracking(bool en);
   bool GetCursorTracking() { return this->Tracked; }
 
+  //! Only redraw the renderers that have changed since the last render.
+  /*!
+   *  When this is on (the default), every render of the render window
+   *  skips the renderers whose panes are not dirty, and their viewports
+   *  keep the pixels from the previous frame.  A renderer that overlaps
+   *  a redrawn renderer is redrawn too, if it would otherwise be erased
+   *  or drawn over.  Everything is redrawn if the window size changes.
+  */
+  void SetPartialRendering(bool en) { this->PartialRendering = en; }
+  bool GetPartialRendering() { return this->PartialRendering; }
+
+  //! Force every renderer to be redrawn at the next render.
+  void SetAllDirty();
+
  protected:
   vtkViewRect();
   ~vtkViewRect();
@@ -132,10 +206,42 @@ class vtkViewRect : public vtkViewObject
   
   bool Tracked;
 
+  bool PartialRendering;
+
+  //! Renderer MTimes after the last render, for renderers without panes.
+  std::map<vtkRenderer *, vtkMTimeType> RenderedMTimes;
+
+  //! The window size at the last render.
+  int RenderedSize[2];
+
+  //! Set when every renderer must be redrawn.
+  bool AllDirty;
+
+  //! Set when RequestRender() or RequestStart() has been called.
+  bool RenderPending;
+  bool StartPending;
+
+  unsigned long RenderRequestCount;
+  unsigned long RenderCount;
+  unsigned long SuppressedRenderCount;
+
  private:
   vtkViewRect(const vtkViewRect&); // Not implemented.
   void operator=(const vtkViewRect&); // Not implemented.
 
+  //! Get the renderers in drawing order, and whether each must be drawn.
+  void ComputeDirtyRenderers(std::vector<vtkRenderer *> *renderers,
+                             std::vector<bool> *dirty);
+
+  //! Choose which renderers to draw, before each render.
+  void StartRenderCallback(vtkObject *, unsigned long, void *);
+
+  //! Record what was drawn, after each render.
+  void EndRenderCallback(vtkObject *, unsigned long, void *);
+
+  //! Get the pane for each renderer, or NULL for renderers without panes.
+  std::map<vtkRenderer *, vtkViewPane *> RequestPanesByRenderer();
+
   //! Keypress callback to enable custom keyboard input.
   static void KeyPressCallbackFunction(vtkObject *caller,
                                        long unsigned int eventId,
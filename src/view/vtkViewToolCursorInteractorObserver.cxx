@@ -63,6 +63,10 @@ vtkViewToolCursorInteractorObserver::vtkViewToolCursorInteractorObserver()
   this->FocusCursor = NULL;
   this->ViewRect = NULL;
   this->FocusButton = 0;
+  this->MovePending = false;
+  this->PendingMovePosition[0] = 0;
+  this->PendingMovePosition[1] = 0;
+  this->PendingRenderTag = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -74,6 +78,7 @@ vtkViewToolCursorInteractorObserver::~vtkViewToolCursorInteractorObserver()
     }
   if (this->ViewRect)
     {
+    this->ViewRect->RemoveObserver(this->PendingRenderTag);
     this->ViewRect->Delete();
     }
 }
@@ -265,15 +270,23 @@ void vtkViewToolCursorInteractorObserver::ProcessEvents(vtkObject *object,
 std::cout << "event: " << vtkCommand::GetStringFromEventId(event) << std::endl;
 #endif
 
+  if (event == vtkCommand::MouseMoveEvent)
+    {
+    // Keep only the latest position, and wait for the next render to
+    // apply it, so that moves which arrive faster than the display can
+    // refresh are dropped instead of each being picked and rendered
+    iren->GetEventPosition(self->PendingMovePosition[0],
+                           self->PendingMovePosition[1]);
+    self->MovePending = true;
+    self->ViewRect->RequestRender();
+    return;
+    }
+
+  // Button and key events must see the cursor where the last move left it
+  self->FlushPendingMove();
+
   switch (event)
     {
-    case vtkCommand::MouseMoveEvent:
-      {
-      int x, y;
-      iren->GetEventPosition(x, y);
-      self->MoveToDisplayPosition(x, y);
-      }
-      break;
 
     case vtkCommand::LeftButtonPressEvent:
     case vtkCommand::RightButtonPressEvent:
@@ -300,10 +313,12 @@ std::cout << "event: " << vtkCommand::GetStringFromEventId(event) << std::endl;
 
       cursor->ComputePosition();
       // Only grab focus if there currently is no focus
+      bool startDrag = false;
       if (self->FocusCursor == NULL)
         {
         self->FocusCursor = cursor;
         self->SetFocusButton(button);
+        startDrag = true;
         }
       self->MoveToDisplayPosition(x, y);
 
@@ -319,6 +334,11 @@ std::cout << "event: " << vtkCommand::GetStringFromEventId(event) << std::endl;
                           self->EventCallbackCommand);
           }
         }
+
+      if (startDrag)
+        {
+        self->ViewRect->InvokeEvent(vtkCommand::StartInteractionEvent);
+        }
       }
       break;
 
@@ -345,9 +365,11 @@ std::cout << "event: " << vtkCommand::GetStringFromEventId(event) << std::endl;
 
       // Only lose focus if there currently is a focus and if the button that
       // gave focus was released.
+      bool endDrag = false;
       if (self->FocusCursor && button == self->GetFocusButton())
         {
         self->FocusCursor = NULL;
+        endDrag = true;
         }
       self->MoveToDisplayPosition(x, y);
 
@@ -359,6 +381,11 @@ std::cout << "event: " << vtkCommand::GetStringFromEventId(event) << std::endl;
           }
         }
         iren->GetRenderWindow()->SetDesiredUpdateRate(0.0001);
+
+      if (endDrag)
+        {
+        self->ViewRect->InvokeEvent(vtkCommand::EndInteractionEvent);
+        }
       }
       break;
 
@@ -411,10 +438,31 @@ void vtkViewToolCursorInteractorObserver::MoveToDisplayPosition(double x,
 
 }
 
+//----------------------------------------------------------------------------
+void vtkViewToolCursorInteractorObserver::FlushPendingMove()
+{
+  if (this->MovePending)
+    {
+    this->MovePending = false;
+    this->MoveToDisplayPosition(this->PendingMovePosition[0],
+                                this->PendingMovePosition[1]);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkViewToolCursorInteractorObserver::PendingRenderCallback(
+  vtkObject *, unsigned long, void *)
+{
+  this->FlushPendingMove();
+}
+
 //----------------------------------------------------------------------------
 void vtkViewToolCursorInteractorObserver::SetViewRect(vtkViewRect *rect)
 {
   this->ViewRect = rect;
   rect->Register(this);
+  this->PendingRenderTag = rect->AddObserver(
+    vtkViewRect::PendingRenderEvent, this,
+    &vtkViewToolCursorInteractorObserver::PendingRenderCallback);
   this->SetInteractor(this->ViewRect->GetInteractor());
 }
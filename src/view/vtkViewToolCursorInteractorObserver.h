@@ -103,6 +103,17 @@ protected:
   */
   void MoveToDisplayPosition(double x, double y);
 
+  //! Apply the latest mouse move, if one has been held back.
+  /*!
+   *  Mouse moves are not applied as they arrive.  Only the position
+   *  of the latest move is kept, and it is applied just before the next
+   *  render, or before any button event so that the order is kept.
+  */
+  void FlushPendingMove();
+
+  //! Called by the vtkViewRect just before a requested render.
+  void PendingRenderCallback(vtkObject *, unsigned long, void *);
+
   //! Simple get method to retrieve the vtkViewRect.
   vtkViewRect *GetViewRect() { return this->ViewRect; }
 
@@ -121,6 +132,15 @@ protected:
   //! Variable to track the mouse button being held down.
   int FocusButton;
 
+  //! Set when a mouse move has been received but not yet applied.
+  bool MovePending;
+
+  //! The display position of the latest mouse move.
+  int PendingMovePosition[2];
+
+  //! The tag for the observer of the vtkViewRect.
+  unsigned long PendingRenderTag;
+
 private:
   vtkViewToolCursorInteractorObserver(const vtkViewToolCursorInteractorObserver&);  //Not implemented
   void operator=(const vtkViewToolCursorInteractorObserver&);  //Not implemented
@@ -0,0 +1,48 @@
+#include "UnitTest++.h"
+
+#include "cbFrameFinder.h"
+#include "cbFramePhantom.h"
+
+SUITE (TestFrameFinder) {
+
+  struct PhantomFixture {
+    PhantomFixture() {
+      // a small rotation and translation, so that the pose is not trivial
+      double angles[3] = { 5.0, 0.0, 0.0 };
+      double translation[3] = { 2.0, -3.0, 1.0 };
+
+      phantom_ = cbFramePhantom::New();
+      phantom_->SetSliceSpacing(2.0);
+      phantom_->SetPose(angles, translation);
+      phantom_->Execute();
+    }
+    ~PhantomFixture() {
+      delete phantom_;
+    }
+
+    cbFramePhantom *phantom_;
+  };
+
+  TEST_FIXTURE (PhantomFixture, ShouldFindFrame) {
+    cbFrameFinder *finder = cbFrameFinder::New();
+    finder->SetInput(phantom_->GetOutput());
+    finder->SetDICOMPatientMatrix(phantom_->GetPatientMatrix());
+    finder->Execute();
+
+    CHECK(finder->GetSuccess());
+    if (finder->GetSuccess()) {
+      double error = cbFramePhantom::MatrixError(
+        finder->GetImageToFrameMatrix(),
+        phantom_->GetImageToFrameMatrix(), false);
+      CHECK(error < 1.0);
+
+      // the rods are found where the matrix puts them
+      CHECK_EQUAL(2, finder->GetNumberOfFiducials());
+      for (int i = 0; i < finder->GetNumberOfFiducials(); i++) {
+        CHECK(finder->GetFiducialRMS(i) < 1.0);
+      }
+    }
+
+    delete finder;
+  }
+}
@@ -0,0 +1,62 @@
+#include "UnitTest++.h"
+
+#include "vtkImageData.h"
+#include "vtkImageNode.h"
+#include "vtkSmartPointer.h"
+
+SUITE (TestImageNode) {
+
+  struct NodeFixture {
+    NodeFixture() {
+      // one voxel for each value from 0 to 99
+      vtkSmartPointer<vtkImageData> image =
+        vtkSmartPointer<vtkImageData>::New();
+      image->SetDimensions(100, 1, 1);
+      image->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+      unsigned short *ptr =
+        static_cast<unsigned short *>(image->GetScalarPointer());
+      for (int i = 0; i < 100; i++) {
+        ptr[i] = i;
+      }
+
+      node_ = vtkImageNode::New();
+      node_->ShallowCopyImage(image);
+    }
+    ~NodeFixture() {
+      node_->Delete();
+    }
+
+    vtkImageNode *node_;
+  };
+
+  TEST_FIXTURE (NodeFixture, ShouldFindFullRange) {
+    double range[2];
+    node_->GetPercentileRange(0.0, 100.0, range);
+    CHECK_CLOSE(0.0, range[0], 1e-6);
+    CHECK_CLOSE(99.0, range[1], 1e-6);
+  }
+
+  TEST_FIXTURE (NodeFixture, ShouldFindPercentiles) {
+    double range[2];
+    node_->GetPercentileRange(10.0, 50.0, range);
+    CHECK_CLOSE(9.0, range[0], 1e-6);
+    CHECK_CLOSE(49.0, range[1], 1e-6);
+  }
+
+  TEST_FIXTURE (NodeFixture, ShouldUpdateWhenImageChanges) {
+    double range[2];
+    node_->GetPercentileRange(0.0, 100.0, range);
+
+    vtkImageData *image = node_->GetImage();
+    unsigned short *ptr =
+      static_cast<unsigned short *>(image->GetScalarPointer());
+    for (int i = 0; i < 100; i++) {
+      ptr[i] += 100;
+    }
+    image->Modified();
+
+    node_->GetPercentileRange(0.0, 100.0, range);
+    CHECK_CLOSE(100.0, range[0], 1e-6);
+    CHECK_CLOSE(199.0, range[1], 1e-6);
+  }
+}
@@ -0,0 +1,54 @@
+#include "UnitTest++.h"
+
+#include "vtkActor.h"
+#include "vtkCamera.h"
+#include "vtkImageViewPane.h"
+#include "vtkProperty.h"
+#include "vtkRenderer.h"
+#include "vtkSmartPointer.h"
+
+SUITE (TestViewPane) {
+
+  struct PaneFixture {
+    PaneFixture() {
+      pane_ = vtkImageViewPane::New();
+    }
+    ~PaneFixture() {
+      pane_->Delete();
+    }
+
+    vtkImageViewPane *pane_;
+  };
+
+  TEST_FIXTURE (PaneFixture, ShouldBeDirtyUntilRendered) {
+    CHECK(pane_->GetDirty());
+    pane_->MarkRendered();
+    CHECK(!pane_->GetDirty());
+  }
+
+  TEST_FIXTURE (PaneFixture, ShouldBeDirtyAfterCameraChange) {
+    pane_->MarkRendered();
+    pane_->GetRenderer()->GetActiveCamera()->Azimuth(10.0);
+    CHECK(pane_->GetDirty());
+  }
+
+  TEST_FIXTURE (PaneFixture, ShouldBeDirtyAfterPropChange) {
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    pane_->GetRenderer()->AddViewProp(actor);
+    pane_->MarkRendered();
+    CHECK(!pane_->GetDirty());
+
+    actor->GetProperty()->SetOpacity(0.5);
+    CHECK(pane_->GetDirty());
+    pane_->MarkRendered();
+
+    pane_->GetRenderer()->RemoveViewProp(actor);
+    CHECK(pane_->GetDirty());
+  }
+
+  TEST_FIXTURE (PaneFixture, ShouldBeDirtyWhenForced) {
+    pane_->MarkRendered();
+    pane_->SetDirty(true);
+    CHECK(pane_->GetDirty());
+  }
+}
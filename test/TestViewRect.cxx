@@ -0,0 +1,54 @@
+#include "UnitTest++.h"
+
+#include "vtkCallbackCommand.h"
+#include "vtkSmartPointer.h"
+#include "vtkViewRect.h"
+
+namespace {
+
+void CountEvent(vtkObject *, unsigned long, void *clientData, void *)
+{
+  int *count = static_cast<int *>(clientData);
+  (*count)++;
+}
+
+} // end anonymous namespace
+
+SUITE (TestViewRect) {
+
+  struct ViewRectFixture {
+    ViewRectFixture() : events_(0) {
+      rect_ = vtkViewRect::New();
+      vtkSmartPointer<vtkCallbackCommand> command =
+        vtkSmartPointer<vtkCallbackCommand>::New();
+      command->SetCallback(CountEvent);
+      command->SetClientData(&events_);
+      rect_->AddObserver(vtkViewRect::RenderRequestedEvent, command);
+    }
+    ~ViewRectFixture() {
+      rect_->Delete();
+    }
+
+    vtkViewRect *rect_;
+    int events_;
+  };
+
+  TEST_FIXTURE (ViewRectFixture, ShouldCoalesceRenderRequests) {
+    rect_->RequestRender();
+    rect_->RequestRender();
+    rect_->RequestStart();
+
+    CHECK(rect_->GetRenderPending());
+    CHECK_EQUAL(1, events_);
+    CHECK_EQUAL(3ul, rect_->GetRenderRequestCount());
+    CHECK_EQUAL(0ul, rect_->GetRenderCount());
+  }
+
+  TEST_FIXTURE (ViewRectFixture, ShouldResetRenderCounts) {
+    rect_->RequestRender();
+    rect_->ResetRenderCounts();
+
+    CHECK_EQUAL(0ul, rect_->GetRenderRequestCount());
+    CHECK_EQUAL(0ul, rect_->GetSuppressedRenderCount());
+  }
+}